@@ -3,8 +3,39 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
 #include <algorithm>
 #include <stack>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <cstdint>
+#include <stdexcept>
+#include <limits>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include <sstream>
+#include <locale>
+#include <list>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cmath>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <malloc.h>
 
 class Iterator
 {
@@ -15,14 +46,440 @@ public:
     virtual ~Iterator() = default;
 };
 
+// Interns menu text into blocks drawn from a memory resource. Views stay
+// valid for the arena's lifetime and each distinct string gets a dense 32-bit
+// id. Every container that keeps text (MenuArena, FrozenMenu, MenuPathIndex,
+// PersistentMenu) owns one, so there is no process-wide pool or lock; the
+// owning container serializes writers. The id table lives on the heap, so
+// its doublings do not strand memory in a monotonic resource.
+class TextArena
+{
+    static const size_t BLOCK_SIZE = 16384;
+
+    struct Block
+    {
+        char *data;
+        size_t size;
+    };
+
+    std::pmr::memory_resource *resource;
+    std::vector<Block> blocks;
+    char *openBlock = nullptr;
+    size_t blockUsed = BLOCK_SIZE;
+    std::vector<std::string_view> texts;
+    // Open-addressed table of ids, so interning allocates nothing beyond
+    // arena blocks and the occasional table doubling. Each slot keeps the
+    // text's hash beside its id: probes compare text only on a hash match,
+    // and doubling the table never reads the text again.
+    static constexpr uint64_t EMPTY_SLOT = std::numeric_limits<uint64_t>::max();
+    std::vector<uint64_t> slots;
+
+    static uint32_t hashOf(std::string_view text)
+    {
+        return static_cast<uint32_t>(std::hash<std::string_view>()(text));
+    }
+
+    static uint32_t idOf(uint64_t slot) { return static_cast<uint32_t>(slot); }
+
+    size_t slotFor(std::string_view text, uint32_t hash) const
+    {
+        size_t mask = slots.size() - 1;
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask)
+        {
+            if (slots[slot] == EMPTY_SLOT ||
+                (slots[slot] >> 32 == hash && texts[idOf(slots[slot])] == text))
+            {
+                return slot;
+            }
+        }
+    }
+
+    void grow()
+    {
+        std::vector<uint64_t> old(std::max<size_t>(64, slots.size() * 2), EMPTY_SLOT);
+        old.swap(slots);
+        size_t mask = slots.size() - 1;
+        for (uint64_t entry : old)
+        {
+            if (entry == EMPTY_SLOT)
+            {
+                continue;
+            }
+            size_t slot = (entry >> 32) & mask;
+            while (slots[slot] != EMPTY_SLOT)
+            {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = entry;
+        }
+    }
+
+    char *allocate(size_t size)
+    {
+        char *data = static_cast<char *>(resource->allocate(size, 1));
+        blocks.push_back({data, size});
+        return data;
+    }
+
+    std::string_view store(std::string_view text)
+    {
+        if (text.size() > BLOCK_SIZE / 4)
+        {
+            char *data = allocate(text.size());
+            std::memcpy(data, text.data(), text.size());
+            return std::string_view(data, text.size());
+        }
+        if (BLOCK_SIZE - blockUsed < text.size())
+        {
+            openBlock = allocate(BLOCK_SIZE);
+            blockUsed = 0;
+        }
+        char *at = openBlock + blockUsed;
+        std::memcpy(at, text.data(), text.size());
+        blockUsed += text.size();
+        return std::string_view(at, text.size());
+    }
+
+public:
+    explicit TextArena(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : resource(resource) {}
+
+    ~TextArena()
+    {
+        for (const Block &block : blocks)
+        {
+            resource->deallocate(block.data, block.size, 1);
+        }
+    }
+
+    TextArena(const TextArena &) = delete;
+    TextArena &operator=(const TextArena &) = delete;
+
+    uint32_t intern(std::string_view text)
+    {
+        if ((texts.size() + 1) * 2 > slots.size())
+        {
+            grow();
+        }
+        uint32_t hash = hashOf(text);
+        size_t slot = slotFor(text, hash);
+        if (slots[slot] != EMPTY_SLOT)
+        {
+            return idOf(slots[slot]);
+        }
+        uint32_t id = static_cast<uint32_t>(texts.size());
+        texts.push_back(text.empty() ? std::string_view() : store(text));
+        slots[slot] = uint64_t(hash) << 32 | id;
+        return id;
+    }
+
+    std::string_view internView(std::string_view text) { return texts[intern(text)]; }
+
+    // Copies text that is unlikely to repeat, skipping the table.
+    std::string_view copy(std::string_view text)
+    {
+        return text.empty() ? std::string_view() : store(text);
+    }
+
+    std::string_view view(uint32_t id) const { return texts[id]; }
+
+    std::optional<std::string_view> find(std::string_view text) const
+    {
+        if (slots.empty())
+        {
+            return std::nullopt;
+        }
+        uint64_t entry = slots[slotFor(text, hashOf(text))];
+        if (entry == EMPTY_SLOT)
+        {
+            return std::nullopt;
+        }
+        return texts[idOf(entry)];
+    }
+
+    size_t size() const { return texts.size(); }
+};
+
+// A node's name and description. Heap nodes copy both into one buffer they
+// own; nodes built by a MenuArena or read from a snapshot borrow text that
+// their container keeps alive.
+class MenuLabel
+{
+    std::unique_ptr<char[]> owned;
+    std::string_view nameText;
+    std::string_view descriptionText;
+
+    MenuLabel() = default;
+
+public:
+    MenuLabel(std::string_view name, std::string_view description)
+        : owned(name.size() + description.size() ? new char[name.size() + description.size()] : nullptr)
+    {
+        char *text = owned.get();
+        std::copy(name.begin(), name.end(), text);
+        std::copy(description.begin(), description.end(), text + name.size());
+        nameText = std::string_view(text, name.size());
+        descriptionText = std::string_view(text + name.size(), description.size());
+    }
+
+    static MenuLabel borrow(std::string_view name, std::string_view description)
+    {
+        MenuLabel label;
+        label.nameText = name;
+        label.descriptionText = description;
+        return label;
+    }
+
+    std::string_view name() const { return nameText; }
+    std::string_view description() const { return descriptionText; }
+};
+
+enum class NodeKind : uint8_t
+{
+    Menu,
+    Item
+};
+
+enum class VisitResult
+{
+    Continue,
+    SkipChildren,
+    Stop
+};
+
+class Menu;
+class MenuItem;
+
+class MenuVisitor
+{
+public:
+    virtual VisitResult visitMenu(Menu &) { return VisitResult::Continue; }
+    virtual VisitResult visitItem(MenuItem &) { return VisitResult::Continue; }
+    virtual ~MenuVisitor() = default;
+};
+
+struct MenuAggregate
+{
+    size_t itemCount = 0;
+    size_t vegetarianCount = 0;
+    // Whole cents, so adding and removing items never drifts the sum.
+    int64_t priceSumCents = 0;
+    double priceMin = std::numeric_limits<double>::infinity();
+    double priceMax = -std::numeric_limits<double>::infinity();
+    // Items priced exactly at each bound, so removing one of several tied
+    // items keeps the bound without rescanning the children.
+    size_t atPriceMin = 0;
+    size_t atPriceMax = 0;
+
+    void addBounds(const MenuAggregate &other)
+    {
+        if (other.priceMin < priceMin)
+        {
+            priceMin = other.priceMin;
+            atPriceMin = other.atPriceMin;
+        }
+        else if (other.priceMin == priceMin)
+        {
+            atPriceMin += other.atPriceMin;
+        }
+        if (other.priceMax > priceMax)
+        {
+            priceMax = other.priceMax;
+            atPriceMax = other.atPriceMax;
+        }
+        else if (other.priceMax == priceMax)
+        {
+            atPriceMax += other.atPriceMax;
+        }
+    }
+
+    void add(const MenuAggregate &other)
+    {
+        itemCount += other.itemCount;
+        vegetarianCount += other.vegetarianCount;
+        priceSumCents += other.priceSumCents;
+        addBounds(other);
+    }
+
+    // `other` must describe items counted here.
+    void subtract(const MenuAggregate &other)
+    {
+        itemCount -= other.itemCount;
+        vegetarianCount -= other.vegetarianCount;
+        priceSumCents -= other.priceSumCents;
+        if (itemCount == 0)
+        {
+            *this = MenuAggregate();
+            return;
+        }
+        if (other.priceMin == priceMin)
+        {
+            atPriceMin -= other.atPriceMin;
+        }
+        if (other.priceMax == priceMax)
+        {
+            atPriceMax -= other.atPriceMax;
+        }
+    }
+
+    // True once the last item at a bound has gone; only a rescan of the
+    // children can find the next one.
+    bool boundsExhausted() const
+    {
+        return itemCount > 0 && (atPriceMin == 0 || atPriceMax == 0);
+    }
+
+    static int64_t toCents(double price)
+    {
+        return std::llround(price * 100);
+    }
+
+    double priceSum() const
+    {
+        return priceSumCents / 100.0;
+    }
+
+    double averagePrice() const
+    {
+        return itemCount ? priceSum() / itemCount : 0;
+    }
+};
+
+class MenuArena;
+class MenuPathIndex;
+class MenuSnapshot;
+class SnapshotMenu;
+class MenuComponent;
+
+struct MenuHandle
+{
+    static const uint32_t NO_SLOT = UINT32_MAX;
+
+    uint32_t slot = NO_SLOT;
+    uint32_t generation = 0;
+
+    bool isAssigned() const { return slot != NO_SLOT; }
+};
+
+class MenuHandleTable
+{
+    struct Slot
+    {
+        MenuComponent *component;
+        uint32_t generation;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    // Nodes do not store their handle; the few that ask for one are found here.
+    std::unordered_map<const MenuComponent *, uint32_t> slot_by_component;
+    mutable std::mutex mutex;
+
+    MenuHandleTable() = default;
+
+public:
+    static MenuHandleTable &getInstance()
+    {
+        static MenuHandleTable table;
+        return table;
+    }
+
+    MenuHandleTable(const MenuHandleTable &) = delete;
+    MenuHandleTable &operator=(const MenuHandleTable &) = delete;
+
+    MenuHandle acquire(MenuComponent *component)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t slot;
+        if (freeSlots.empty())
+        {
+            slot = static_cast<uint32_t>(slots.size());
+            slots.push_back({component, 0});
+        }
+        else
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot].component = component;
+        }
+        slot_by_component.emplace(component, slot);
+        return {slot, slots[slot].generation};
+    }
+
+    MenuHandle handleOf(const MenuComponent *component) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint32_t slot = slot_by_component.at(component);
+        return {slot, slots[slot].generation};
+    }
+
+    void release(const MenuComponent *component)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = slot_by_component.find(component);
+        Slot &slot = slots[it->second];
+        slot.component = nullptr;
+        ++slot.generation;
+        freeSlots.push_back(it->second);
+        slot_by_component.erase(it);
+    }
+
+    MenuComponent *resolve(MenuHandle handle) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (handle.slot >= slots.size() || slots[handle.slot].generation != handle.generation)
+        {
+            return nullptr;
+        }
+        return slots[handle.slot].component;
+    }
+};
+
+enum class ChildOrder
+{
+    Preserve,
+    Unordered
+};
+
 class MenuComponent
 {
+    friend class Menu;
+    friend class MenuArena;
+    friend class MenuSnapshot;
+    friend struct ComponentDeleter;
+
+    enum : uint8_t
+    {
+        IN_ARENA = 1,
+        HAS_HANDLE = 2,
+        READ_ONLY = 4
+    };
+
+    Menu *parent = nullptr;
+    uint32_t childIndex = 0;
+    uint8_t flags = 0;
+
+protected:
+    void requireWritable() const
+    {
+        if (flags & READ_ONLY)
+        {
+            throw std::logic_error("Snapshot menus are read-only");
+        }
+    }
+
 public:
-    virtual std::string getName() const
+    Menu *getParent() const { return parent; }
+    MenuHandle getHandle();
+
+    virtual NodeKind getKind() const = 0;
+    virtual VisitResult accept(MenuVisitor &visitor) = 0;
+
+    virtual std::string_view getName() const
     {
         throw std::runtime_error("Unsupported Operation");
     }
-    virtual std::string getDescription() const
+    virtual std::string_view getDescription() const
     {
         throw std::runtime_error("Unsupported Operation");
     }
@@ -34,6 +491,7 @@ public:
     {
         throw std::runtime_error("Unsupported Operation");
     }
+    virtual MenuAggregate getAggregate() const = 0;
     virtual void print() const
     {
         throw std::runtime_error("Unsupported Operation");
@@ -55,7 +513,13 @@ public:
         throw std::runtime_error("Unsupported Operation");
     }
 
-    virtual ~MenuComponent() = default;
+    virtual ~MenuComponent()
+    {
+        if (flags & HAS_HANDLE)
+        {
+            MenuHandleTable::getInstance().release(this);
+        }
+    }
 };
 
 class NullIterator : public Iterator
@@ -68,23 +532,35 @@ public:
 
 class MenuItem : public MenuComponent
 {
-    std::string name;
-    std::string description;
+    MenuLabel label;
     bool vegetarian;
     double price;
 
 public:
-    MenuItem(const std::string &name, const std::string &description, bool vegetarian, double price)
-        : name(name), description(description), vegetarian(vegetarian), price(price) {}
+    MenuItem(std::string_view name, std::string_view description, bool vegetarian, double price)
+        : label(name, description), vegetarian(vegetarian), price(price) {}
+
+    MenuItem(MenuLabel label, bool vegetarian, double price)
+        : label(std::move(label)), vegetarian(vegetarian), price(price) {}
 
-    std::string getName() const override
+    std::string_view getName() const override
     {
-        return name;
+        return label.name();
     }
 
-    std::string getDescription() const override
+    std::string_view getDescription() const override
     {
-        return description;
+        return label.description();
+    }
+
+    NodeKind getKind() const override
+    {
+        return NodeKind::Item;
+    }
+
+    VisitResult accept(MenuVisitor &visitor) override
+    {
+        return visitor.visitItem(*this) == VisitResult::Stop ? VisitResult::Stop : VisitResult::Continue;
     }
 
     bool isVegetarian() const override
@@ -97,15 +573,35 @@ public:
         return price;
     }
 
-    void print() const override
+    // Updates the aggregates of every enclosing menu in O(depth).
+    void setPrice(double price);
+
+    MenuAggregate getAggregate() const override
     {
-        std::cout << "  " << getName();
+        MenuAggregate aggregate;
+        aggregate.itemCount = 1;
+        aggregate.vegetarianCount = vegetarian ? 1 : 0;
+        aggregate.priceSumCents = MenuAggregate::toCents(price);
+        aggregate.priceMin = aggregate.priceMax = price;
+        aggregate.atPriceMin = aggregate.atPriceMax = 1;
+        return aggregate;
+    }
+
+    void render(std::ostream &out) const
+    {
+        out << "  " << getName();
         if (isVegetarian())
         {
-            std::cout << " (v)";
+            out << " (v)";
         }
-        std::cout << ", " << getPrice() << std::endl;
-        std::cout << "     -- " << getDescription() << std::endl;
+        out << ", " << getPrice() << "\n";
+        out << "     -- " << getDescription() << "\n";
+    }
+
+    void print() const override
+    {
+        render(std::cout);
+        std::cout.flush();
     }
 
     Iterator *createIterator()
@@ -114,88 +610,260 @@ public:
     }
 };
 
-class Menu : public MenuComponent
+// One menu's own print output: the header and item lines, split into runs
+// around each submenu, which renders from its own cache. Built whole and
+// never changed after it is published, and keyed by the number formatting of
+// the stream it was built for.
+struct RenderedMenu
 {
-    std::string name;
-    std::string description;
-
-    typedef std::vector<std::unique_ptr<MenuComponent>> ComponentList;
-    ComponentList components;
+    std::vector<std::string> runs;
+    std::vector<const Menu *> submenus;
+    std::ios_base::fmtflags flags;
+    std::streamsize precision;
+    std::locale locale;
 
-    class MenuIterator : public Iterator
+    bool formatsLike(const std::ostream &out) const
     {
-        ComponentList &components;
-        ComponentList::iterator _it;
+        return flags == out.flags() && precision == out.precision() && locale == out.getloc();
+    }
+};
 
-    public:
-        MenuIterator(ComponentList &components) : components(components)
+// Segments of a rendered tree, and the caches they point into.
+class MenuRendering
+{
+    std::vector<std::string_view> segments;
+    std::vector<std::shared_ptr<const RenderedMenu>> caches;
+    size_t formatted = 0;
+
+    friend class Menu;
+
+public:
+    // Bytes this rendering had to format instead of reusing a cache.
+    size_t formattedBytes() const { return formatted; }
+
+    size_t size() const
+    {
+        size_t bytes = 0;
+        for (std::string_view segment : segments)
         {
-            _it = components.begin();
+            bytes += segment.size();
         }
+        return bytes;
+    }
 
-        void *next() override
+    void writeTo(std::ostream &out) const
+    {
+        for (std::string_view segment : segments)
         {
-            if (!hasNext())
-                return nullptr;
-            return (_it++)->get();
+            out.write(segment.data(), segment.size());
         }
+    }
+};
 
-        bool hasNext() override
+struct ComponentDeleter
+{
+    void operator()(MenuComponent *component) const
+    {
+        if (component->flags & MenuComponent::IN_ARENA)
         {
-            return _it != components.end();
+            component->~MenuComponent();
         }
-        void remove() override { throw std::runtime_error("Unsupported Operation"); }
-    };
+        else
+        {
+            delete component;
+        }
+    }
+};
 
-public:
-    Menu(const std::string &name, const std::string &description) : name(name), description(description) {}
+class Menu : public MenuComponent
+{
+protected:
+    typedef std::pmr::vector<std::unique_ptr<MenuComponent, ComponentDeleter>> ComponentList;
 
-    std::string getName() const override
-    {
-        return name;
-    }
+private:
+    MenuLabel label;
+    ComponentList components;
+    MenuAggregate aggregate;
+    MenuPathIndex *pathIndex = nullptr;
+    // Read and replaced with std::atomic_load/atomic_store, so concurrent
+    // prints of an unchanged menu are safe. Editing a menu while another
+    // thread prints or traverses it is not; PersistentMenu covers that.
+    mutable std::shared_ptr<const RenderedMenu> rendered;
 
-    std::string getDescription() const override
-    {
-        return description;
-    }
+    friend class MenuPathIndex;
+    friend class MenuSnapshot;
+    friend class CompositeIterator;
+
+    std::shared_ptr<const RenderedMenu> buildRender(const std::ostream &format) const;
 
-    void addComponent(MenuComponent *component) override
+    void invalidateRender()
     {
-        components.emplace_back((component));
+        std::atomic_store(&rendered, std::shared_ptr<const RenderedMenu>());
     }
 
-    void removeComponent(MenuComponent *component) override
+    bool isChild(const MenuComponent *component) const
     {
-        components.erase(std::remove_if(components.begin(), components.end(),
-                                        [component](const std::unique_ptr<MenuComponent> &ptr)
-                                        { return ptr.get() == component; }),
-                         components.end());
+        return component && component->parent == this && component->childIndex < components.size() &&
+               components[component->childIndex].get() == component;
     }
 
-    MenuComponent *getChild(int index) override
+    MenuAggregate detach(MenuComponent *component);
+    void applyRemoval(const MenuAggregate &removed);
+    void applyItemChange(const MenuAggregate &before, const MenuAggregate &after);
+
+    friend class MenuItem;
+
+    bool hasIndexedAncestor() const
     {
-        if (index < 0 || index >= static_cast<int>(components.size()))
+        for (const Menu *menu = this; menu; menu = menu->parent)
         {
-            throw std::out_of_range("Index out of range");
+            if (menu->pathIndex)
+            {
+                return true;
+            }
         }
-        return components[index].get();
+        return false;
     }
 
-    void print() const override
-    {
-        std::cout << std::endl
-                  << getName() << ", " << getDescription() << std::endl;
-        std::cout << "---------------------" << std::endl;
+    void attachPathIndex(MenuPathIndex *index);
 
+    void recomputeBounds()
+    {
+        aggregate.priceMin = std::numeric_limits<double>::infinity();
+        aggregate.priceMax = -std::numeric_limits<double>::infinity();
+        aggregate.atPriceMin = aggregate.atPriceMax = 0;
         for (const auto &component : components)
         {
-            component->print();
+            aggregate.addBounds(component->getAggregate());
         }
     }
 
-    Iterator *createIterator();
-};
+    class MenuIterator : public Iterator
+    {
+        const ComponentList &components;
+        ComponentList::const_iterator _it;
+
+    public:
+        MenuIterator(Menu &menu) : components(menu.children())
+        {
+            _it = components.begin();
+        }
+
+        void *next() override
+        {
+            if (!hasNext())
+                return nullptr;
+            return (_it++)->get();
+        }
+
+        bool hasNext() override
+        {
+            return _it != components.end();
+        }
+        void remove() override { throw std::runtime_error("Unsupported Operation"); }
+    };
+
+protected:
+    Menu(MenuLabel label, const MenuAggregate &aggregate) : label(std::move(label)), aggregate(aggregate) {}
+
+    void adopt(MenuComponent *component);
+
+    // Every read of the child list goes through here, so a subclass can
+    // create the children on first use.
+    virtual const ComponentList &children() const
+    {
+        return components;
+    }
+
+public:
+    Menu(std::string_view name, std::string_view description,
+         std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : label(name, description), components(resource) {}
+
+    Menu(MenuLabel label, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : label(std::move(label)), components(resource) {}
+
+    ~Menu();
+
+    std::string_view getName() const override
+    {
+        return label.name();
+    }
+
+    std::string_view getDescription() const override
+    {
+        return label.description();
+    }
+
+    NodeKind getKind() const override
+    {
+        return NodeKind::Menu;
+    }
+
+    // Walks the subtree with an explicit stack, so depth is bounded by the
+    // heap rather than the call stack.
+    VisitResult accept(MenuVisitor &visitor) override;
+
+    void addComponent(MenuComponent *component) override;
+
+    void removeComponent(MenuComponent *component) override
+    {
+        removeComponent(component, ChildOrder::Preserve);
+    }
+
+    void removeComponent(MenuComponent *component, ChildOrder order);
+    bool removeComponent(MenuHandle handle, ChildOrder order = ChildOrder::Preserve);
+    void removeComponents(const std::vector<MenuComponent *> &removed, ChildOrder order = ChildOrder::Preserve);
+
+    MenuAggregate getAggregate() const override
+    {
+        return aggregate;
+    }
+
+    MenuComponent *getChild(int index) override
+    {
+        const ComponentList &list = children();
+        if (index < 0 || index >= static_cast<int>(list.size()))
+        {
+            throw std::out_of_range("Index out of range");
+        }
+        return list[index].get();
+    }
+
+    int getNumberOfChildren() const
+    {
+        return static_cast<int>(children().size());
+    }
+
+    // Gathers cached segments, rebuilding only menus edited since their last
+    // render or last rendered with different number formatting than `format`.
+    void render(MenuRendering &out, const std::ostream &format = std::cout) const;
+
+    void print() const override;
+
+    Iterator *createIterator();
+};
+
+// A menu read from a MenuSnapshot. Its name, description and aggregate come
+// from its entry in the parent's block; its children are created from its
+// own block the first time anything reads them.
+class SnapshotMenu : public Menu
+{
+    friend class MenuSnapshot;
+
+    MenuSnapshot &snapshot;
+    uint32_t block;
+    bool loaded = false;
+    bool resident = false;
+    std::list<SnapshotMenu *>::iterator lruPosition;
+
+protected:
+    const ComponentList &children() const override;
+
+public:
+    SnapshotMenu(MenuSnapshot &snapshot, uint32_t block, MenuLabel label, const MenuAggregate &aggregate)
+        : Menu(std::move(label), aggregate), snapshot(snapshot), block(block) {}
+};
 
 class CompositeIterator : public Iterator
 {
@@ -213,9 +881,11 @@ public:
             return nullptr;
         auto &iterator = _stack.top();
         MenuComponent *component = static_cast<MenuComponent *>(iterator->next());
-        if (Menu *menu = dynamic_cast<Menu *>(component))
+        // A submenu's createIterator() is itself composite, so descending
+        // through it would visit every deeper node once more per level.
+        if (component->getKind() == NodeKind::Menu)
         {
-            _stack.emplace(component->createIterator());
+            _stack.emplace(new Menu::MenuIterator(*static_cast<Menu *>(component)));
         }
         return component;
     }
@@ -238,70 +908,2895 @@ public:
 
 Iterator *Menu::createIterator()
 {
-    return new CompositeIterator(new MenuIterator(components));
+    return new CompositeIterator(new MenuIterator(*this));
 }
 
-class Waitress
+// Builds menus whose nodes, child lists and text all come from one
+// monotonic resource. While no node needs its destructor run, destroying the
+// arena releases everything in one step. Adopting a heap node, asking for a
+// handle or rendering marks the arena for teardown: every node no parent ever
+// adopted is then destroyed, and those destructors release the rest. Nodes
+// must not outlive their arena, even when adopted by a heap menu.
+class MenuArena
 {
-    MenuComponent *menus;
+    friend class Menu;
+    friend class MenuComponent;
+
+    std::pmr::monotonic_buffer_resource resource;
+    TextArena text;
+    // Nodes whose destructors may have work to do: every menu, and items
+    // that took a handle.
+    std::pmr::vector<MenuComponent *> tracked;
+    Menu *rootMenu;
+    bool needsTeardown = false;
+
+    // Each node is preceded by one word holding its arena's address, with the
+    // low bit set once a parent adopts it. The word outlives the node, so
+    // teardown can tell orphans apart without touching destroyed nodes.
+    static constexpr uintptr_t ADOPTED = 1;
+
+    static uintptr_t &header(const MenuComponent *component)
+    {
+        return *reinterpret_cast<uintptr_t *>(reinterpret_cast<uintptr_t>(component) - sizeof(uintptr_t));
+    }
+
+    static MenuArena *of(const MenuComponent *component)
+    {
+        return reinterpret_cast<MenuArena *>(header(component) & ~ADOPTED);
+    }
+
+    static void markAdopted(const MenuComponent *component)
+    {
+        header(component) |= ADOPTED;
+    }
+
+    static bool sameArena(const MenuComponent *a, const MenuComponent *b)
+    {
+        return (a->flags & b->flags & MenuComponent::IN_ARENA) && of(a) == of(b);
+    }
+
+    void track(MenuComponent *component)
+    {
+        tracked.push_back(component);
+    }
+
+    void requireTeardown() { needsTeardown = true; }
+
+    // Relies on MenuComponent being the first base of every node type, so a
+    // MenuComponent pointer and the node share an address.
+    template <typename Component, typename... Args>
+    Component *create(Args &&...args)
+    {
+        constexpr size_t offset = (sizeof(uintptr_t) + alignof(Component) - 1) / alignof(Component) * alignof(Component);
+        char *memory = static_cast<char *>(
+            resource.allocate(offset + sizeof(Component), std::max(alignof(Component), alignof(uintptr_t))));
+        new (memory + offset - sizeof(uintptr_t)) uintptr_t(reinterpret_cast<uintptr_t>(this));
+        Component *component = new (memory + offset) Component(std::forward<Args>(args)...);
+        component->flags |= MenuComponent::IN_ARENA;
+        return component;
+    }
 
 public:
-    Waitress(MenuComponent *menus) : menus(menus) {}
-    void printMenu() const
+    MenuArena(std::string_view name, std::string_view description, size_t initialBytes = 64 * 1024)
+        : resource(initialBytes), text(&resource), tracked(&resource)
     {
-        menus->print();
+        rootMenu = createMenu(name, description);
     }
 
-    void printVegetarianMenu()
+    ~MenuArena()
     {
-        std::unique_ptr<Iterator> iterator(menus->createIterator());
-        while (iterator->hasNext())
+        if (!needsTeardown)
+        {
+            return;
+        }
+        for (MenuComponent *component : tracked)
+        {
+            if (!(header(component) & ADOPTED))
+            {
+                component->~MenuComponent();
+            }
+        }
+    }
+
+    MenuArena(const MenuArena &) = delete;
+    MenuArena &operator=(const MenuArena &) = delete;
+
+    Menu *root() const { return rootMenu; }
+
+    // Names are copied as given; descriptions, which menus tend to share,
+    // are interned.
+    Menu *createMenu(std::string_view name, std::string_view description)
+    {
+        Menu *menu = create<Menu>(MenuLabel::borrow(text.copy(name), text.internView(description)), &resource);
+        track(menu);
+        return menu;
+    }
+
+    MenuItem *createItem(std::string_view name, std::string_view description, bool vegetarian, double price)
+    {
+        return create<MenuItem>(MenuLabel::borrow(text.copy(name), text.internView(description)), vegetarian, price);
+    }
+};
+
+// Every index on a menu or any of its ancestors is updated by addComponent and
+// removeComponent. Destroying the indexed menu first leaves the index empty.
+class MenuPathIndex
+{
+    friend class Menu;
+
+    Menu *root;
+    std::unordered_map<std::string, std::vector<MenuComponent *>> components_by_path;
+    // Keys view names interned here, so they outlive removed components.
+    TextArena names;
+    std::unordered_map<std::string_view, std::vector<MenuComponent *>> components_by_name;
+
+    static void erase(std::vector<MenuComponent *> &list, MenuComponent *component)
+    {
+        list.erase(std::remove(list.begin(), list.end(), component), list.end());
+    }
+
+    void indexSubtree(MenuComponent *component, std::string &path, bool add)
+    {
+        size_t prefixLength = path.size();
+        if (!path.empty())
+        {
+            path += '/';
+        }
+        path += component->getName();
+        if (add)
+        {
+            components_by_path[path].push_back(component);
+            components_by_name[names.internView(component->getName())].push_back(component);
+        }
+        else
+        {
+            auto byPath = components_by_path.find(path);
+            erase(byPath->second, component);
+            if (byPath->second.empty())
+                components_by_path.erase(byPath);
+            auto byName = components_by_name.find(component->getName());
+            erase(byName->second, component);
+            if (byName->second.empty())
+                components_by_name.erase(byName);
+        }
+        if (component->getKind() == NodeKind::Menu)
         {
-            MenuComponent *menuComponent = static_cast<MenuComponent *>(iterator->next());
-            try
+            Menu *menu = static_cast<Menu *>(component);
+            for (int i = 0; i < menu->getNumberOfChildren(); ++i)
             {
-                if (menuComponent->isVegetarian())
-                    menuComponent->print();
+                indexSubtree(menu->getChild(i), path, add);
             }
-            catch (const std::runtime_error &e)
+        }
+        path.resize(prefixLength);
+    }
+
+    template <typename Visit>
+    static void visitSubtree(MenuComponent *component, std::string &path, Visit &visit)
+    {
+        visit(std::string_view(path), component);
+        if (component->getKind() == NodeKind::Menu)
+        {
+            Menu *menu = static_cast<Menu *>(component);
+            for (int i = 0; i < menu->getNumberOfChildren(); ++i)
+            {
+                MenuComponent *child = menu->getChild(i);
+                size_t prefixLength = path.size();
+                path += '/';
+                path += child->getName();
+                visitSubtree(child, path, visit);
+                path.resize(prefixLength);
+            }
+        }
+    }
+
+    void detachRoot()
+    {
+        root = nullptr;
+        components_by_path.clear();
+        components_by_name.clear();
+    }
+
+public:
+    // Paths join names with '/', so a name containing one would be ambiguous.
+    static void requireIndexableNames(MenuComponent *subtree)
+    {
+        std::vector<MenuComponent *> pending{subtree};
+        while (!pending.empty())
+        {
+            MenuComponent *component = pending.back();
+            pending.pop_back();
+            if (component->getName().find('/') != std::string_view::npos)
             {
+                throw std::invalid_argument("Indexed menu names cannot contain '/': " + std::string(component->getName()));
             }
+            if (component->getKind() == NodeKind::Menu)
+            {
+                Menu *menu = static_cast<Menu *>(component);
+                for (int i = 0; i < menu->getNumberOfChildren(); ++i)
+                {
+                    pending.push_back(menu->getChild(i));
+                }
+            }
+        }
+    }
+
+    explicit MenuPathIndex(Menu *root) : root(root)
+    {
+        if (root->pathIndex)
+        {
+            throw std::logic_error("Menu already has a path index");
+        }
+        requireIndexableNames(root);
+        std::string path;
+        indexSubtree(root, path, true);
+        root->attachPathIndex(this);
+    }
+
+    ~MenuPathIndex()
+    {
+        if (root)
+        {
+            root->pathIndex = nullptr;
+        }
+    }
+
+    MenuPathIndex(const MenuPathIndex &) = delete;
+    MenuPathIndex &operator=(const MenuPathIndex &) = delete;
+
+    std::string pathOf(MenuComponent *component) const
+    {
+        std::vector<std::string_view> names;
+        MenuComponent *node = component;
+        for (; node && node != root; node = node->getParent())
+        {
+            names.push_back(node->getName());
+        }
+        if (node != root)
+        {
+            throw std::invalid_argument("Component is not under the indexed menu");
+        }
+        std::string path(root->getName());
+        for (auto name = names.rbegin(); name != names.rend(); ++name)
+        {
+            path += '/';
+            path += *name;
+        }
+        return path;
+    }
+
+    void addSubtree(MenuComponent *component)
+    {
+        std::string path = pathOf(component->getParent());
+        indexSubtree(component, path, true);
+    }
+
+    void removeSubtree(MenuComponent *component)
+    {
+        std::string path = pathOf(component->getParent());
+        indexSubtree(component, path, false);
+    }
+
+    MenuComponent *find(const std::string &path) const
+    {
+        auto it = components_by_path.find(path);
+        return it == components_by_path.end() ? nullptr : it->second.front();
+    }
+
+    std::vector<MenuComponent *> findByName(std::string_view name) const
+    {
+        auto it = components_by_name.find(name);
+        return it == components_by_name.end() ? std::vector<MenuComponent *>() : it->second;
+    }
+
+    template <typename Visit>
+    void forEachUnder(const std::string &path, Visit visit) const
+    {
+        MenuComponent *component = find(path);
+        if (!component)
+        {
+            return;
         }
+        std::string prefix = path;
+        visitSubtree(component, prefix, visit);
     }
+
+    size_t size() const { return components_by_path.size(); }
 };
 
-int main()
+struct SnapshotHeader
 {
+    char magic[8];
+    uint32_t version;
+    uint32_t blockCount;
+    uint64_t blockTableOffset;
+};
 
-    MenuComponent *pancakeHouseMenu = new Menu("Pancake House", "Breakfast");
-    MenuComponent *dinerMenu = new Menu("Diner", "Lunch");
-    MenuComponent *cafeMenu = new Menu("Cafe", "Evenings");
-    MenuComponent *dessertMenu = new Menu("Dessert Menu", "Dessert of course!");
+struct SnapshotBlockRef
+{
+    uint64_t offset;
+    uint64_t size;
+};
 
-    MenuComponent *allMenus = new Menu("All Menus", "All available menus");
-    allMenus->addComponent(pancakeHouseMenu);
-    allMenus->addComponent(dinerMenu);
-    allMenus->addComponent(cafeMenu);
+struct SnapshotBlockHeader
+{
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t textSize;
+};
 
-    pancakeHouseMenu->addComponent(new MenuItem("Fruit Bowl", "A bowl of fresh fruit", true, 3.99));
-    dinerMenu->addComponent(new MenuItem("Pasta", "Spaghetti with Marinara Sauce, and a slice of sourdough bread", true, 3.89));
-    cafeMenu->addComponent(new MenuItem("Veggie Burger and Air Fries", "Veggie burger on a whole wheat bun, lettuce, tomato, and fries", true, 6.95));
+struct SnapshotEntry
+{
+    double price;
+    int64_t priceSumCents;
+    double priceMin;
+    double priceMax;
+    uint64_t atPriceMin;
+    uint64_t atPriceMax;
+    uint64_t itemCount;
+    uint64_t vegetarianCount;
+    uint32_t name;
+    uint32_t nameLength;
+    uint32_t description;
+    uint32_t descriptionLength;
+    uint32_t block;
+    uint8_t kind;
+    uint8_t vegetarian;
+    uint8_t reserved[2];
+};
 
-    dinerMenu->addComponent(dessertMenu);
-    dessertMenu->addComponent(new MenuItem("Apple Pie", "Apple pie with a flaky crust, topped with vanilla ice cream", true, 1.59));
+static const char SNAPSHOT_MAGIC[8] = {'M', 'E', 'N', 'U', 'S', 'N', 'P', '\0'};
+static const uint32_t SNAPSHOT_VERSION = 3;
+static const uint64_t SNAPSHOT_BLOCK_ALIGNMENT = 4096;
 
-    Waitress waitress(allMenus);
-    waitress.printMenu();
+// Lays a menu tree out as one block per menu: an entry for each child, with
+// its aggregates, followed by the children's text. Loading maps the file
+// once and creates a menu's children from its block the first time they are
+// read, with names and descriptions viewing the mapping in place. Blocks past
+// the resident limit are evicted least recently used first, which hands their
+// pages back to the kernel; the file-backed mapping pages them in again if
+// they are read later. Node objects are therefore kept until the snapshot is
+// destroyed, so pointers from getChild, iterators, handles and indexes stay
+// valid: the limit bounds mapped block memory, not the small per-node objects
+// of menus already visited.
+class MenuSnapshot
+{
+    std::string path;
+    void *mapping = MAP_FAILED;
+    size_t fileSize = 0;
+    size_t residentLimit;
+    size_t residentBytes = 0;
+    std::vector<SnapshotBlockRef> blocks;
+    // A block may back only one menu, which rules out cycles and shared
+    // subtrees in a corrupt file.
+    std::vector<bool> claimed;
+    std::list<SnapshotMenu *> lru;
+    mutable std::mutex mutex;
+    std::unique_ptr<SnapshotMenu> rootMenu;
 
-    std::cout << std::endl;
+    static uint64_t align(uint64_t offset, uint64_t alignment)
+    {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
 
-    waitress.printVegetarianMenu();
-    std::cout << std::endl;
+    static std::string encodeBlock(Menu *root, std::vector<Menu *> &menus, size_t block)
+    {
+        std::vector<MenuComponent *> children;
+        if (block == 0)
+        {
+            children.push_back(root);
+        }
+        else
+        {
+            for (int i = 0; i < menus[block]->getNumberOfChildren(); ++i)
+            {
+                children.push_back(menus[block]->getChild(i));
+            }
+        }
+        std::vector<SnapshotEntry> entries;
+        std::string text;
+        for (MenuComponent *child : children)
+        {
+            SnapshotEntry entry{};
+            std::string_view name = child->getName();
+            std::string_view description = child->getDescription();
+            entry.name = static_cast<uint32_t>(text.size());
+            entry.nameLength = static_cast<uint32_t>(name.size());
+            text += name;
+            entry.description = static_cast<uint32_t>(text.size());
+            entry.descriptionLength = static_cast<uint32_t>(description.size());
+            text += description;
+            MenuAggregate aggregate = child->getAggregate();
+            entry.priceSumCents = aggregate.priceSumCents;
+            entry.priceMin = aggregate.priceMin;
+            entry.priceMax = aggregate.priceMax;
+            entry.atPriceMin = aggregate.atPriceMin;
+            entry.atPriceMax = aggregate.atPriceMax;
+            entry.itemCount = aggregate.itemCount;
+            entry.vegetarianCount = aggregate.vegetarianCount;
+            entry.kind = static_cast<uint8_t>(child->getKind());
+            if (child->getKind() == NodeKind::Menu)
+            {
+                entry.block = static_cast<uint32_t>(menus.size());
+                menus.push_back(static_cast<Menu *>(child));
+            }
+            else
+            {
+                entry.price = child->getPrice();
+                entry.vegetarian = child->isVegetarian();
+            }
+            entries.push_back(entry);
+        }
+        SnapshotBlockHeader header{};
+        header.entryCount = static_cast<uint32_t>(entries.size());
+        header.textSize = text.size();
+        std::string encoded(reinterpret_cast<const char *>(&header), sizeof(header));
+        encoded.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(SnapshotEntry));
+        encoded += text;
+        return encoded;
+    }
 
-    waitress.printVegetarianMenu();
-    std::cout << std::endl;
+    const char *at(uint64_t offset) const
+    {
+        return static_cast<const char *>(mapping) + offset;
+    }
 
-    waitress.printVegetarianMenu();
+    void readIndex()
+    {
+        SnapshotHeader header{};
+        if (fileSize < sizeof(header))
+        {
+            throw std::runtime_error("Truncated menu snapshot: " + path);
+        }
+        std::memcpy(&header, at(0), sizeof(header));
+        if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+        {
+            throw std::runtime_error("Not a menu snapshot: " + path);
+        }
+        if (header.version != SNAPSHOT_VERSION)
+        {
+            throw std::runtime_error("Unsupported menu snapshot version " + std::to_string(header.version) + ": " + path);
+        }
+        if (header.blockCount < 2 || header.blockCount > fileSize / sizeof(SnapshotBlockRef) ||
+            header.blockTableOffset > fileSize ||
+            fileSize - header.blockTableOffset < uint64_t(header.blockCount) * sizeof(SnapshotBlockRef))
+        {
+            throw std::runtime_error("Corrupt menu snapshot block table: " + path);
+        }
+        blocks.resize(header.blockCount);
+        std::memcpy(blocks.data(), at(header.blockTableOffset), blocks.size() * sizeof(SnapshotBlockRef));
+        for (const SnapshotBlockRef &ref : blocks)
+        {
+            if (ref.offset % 8 != 0 || ref.offset > fileSize || ref.size > fileSize - ref.offset ||
+                ref.size < sizeof(SnapshotBlockHeader))
+            {
+                throw std::runtime_error("Truncated menu snapshot: " + path);
+            }
+        }
+        claimed.assign(blocks.size(), false);
+        claimed[0] = true;
+        std::vector<std::unique_ptr<MenuComponent, ComponentDeleter>> root = decode(0);
+        if (root.size() != 1 || root.front()->getKind() != NodeKind::Menu)
+        {
+            throw std::runtime_error("Corrupt menu snapshot root: " + path);
+        }
+        rootMenu.reset(static_cast<SnapshotMenu *>(root.front().release()));
+    }
+
+    // Validates the whole block and claims its child blocks before creating
+    // any node, so a corrupt block leaves nothing half-built.
+    std::vector<std::unique_ptr<MenuComponent, ComponentDeleter>> decode(uint32_t block)
+    {
+        const SnapshotBlockRef &ref = blocks[block];
+        const SnapshotBlockHeader *header = reinterpret_cast<const SnapshotBlockHeader *>(at(ref.offset));
+        uint64_t available = ref.size - sizeof(SnapshotBlockHeader);
+        if (header->entryCount > available / sizeof(SnapshotEntry) ||
+            header->textSize > available - uint64_t(header->entryCount) * sizeof(SnapshotEntry))
+        {
+            throw std::runtime_error("Corrupt menu snapshot block: " + path);
+        }
+        const SnapshotEntry *entries = reinterpret_cast<const SnapshotEntry *>(header + 1);
+        const char *text = reinterpret_cast<const char *>(entries + header->entryCount);
+        std::vector<uint32_t> childBlocks;
+        for (uint32_t i = 0; i < header->entryCount; ++i)
+        {
+            const SnapshotEntry &entry = entries[i];
+            bool isMenu = entry.kind == static_cast<uint8_t>(NodeKind::Menu);
+            if (uint64_t(entry.name) + entry.nameLength > header->textSize ||
+                uint64_t(entry.description) + entry.descriptionLength > header->textSize ||
+                (!isMenu && entry.kind != static_cast<uint8_t>(NodeKind::Item)) ||
+                (isMenu && (entry.block >= blocks.size() || claimed[entry.block])))
+            {
+                throw std::runtime_error("Corrupt menu snapshot entry: " + path);
+            }
+            if (isMenu)
+            {
+                childBlocks.push_back(entry.block);
+            }
+        }
+        std::sort(childBlocks.begin(), childBlocks.end());
+        if (std::adjacent_find(childBlocks.begin(), childBlocks.end()) != childBlocks.end())
+        {
+            throw std::runtime_error("Corrupt menu snapshot entry: " + path);
+        }
+        for (uint32_t childBlock : childBlocks)
+        {
+            claimed[childBlock] = true;
+        }
+
+        std::vector<std::unique_ptr<MenuComponent, ComponentDeleter>> children;
+        children.reserve(header->entryCount);
+        for (uint32_t i = 0; i < header->entryCount; ++i)
+        {
+            const SnapshotEntry &entry = entries[i];
+            MenuLabel label = MenuLabel::borrow(std::string_view(text + entry.name, entry.nameLength),
+                                                std::string_view(text + entry.description, entry.descriptionLength));
+            if (entry.kind == static_cast<uint8_t>(NodeKind::Item))
+            {
+                children.emplace_back(new MenuItem(std::move(label), entry.vegetarian, entry.price));
+            }
+            else
+            {
+                MenuAggregate aggregate;
+                aggregate.itemCount = static_cast<size_t>(entry.itemCount);
+                aggregate.vegetarianCount = static_cast<size_t>(entry.vegetarianCount);
+                aggregate.priceSumCents = entry.priceSumCents;
+                aggregate.priceMin = entry.priceMin;
+                aggregate.priceMax = entry.priceMax;
+                aggregate.atPriceMin = static_cast<size_t>(entry.atPriceMin);
+                aggregate.atPriceMax = static_cast<size_t>(entry.atPriceMax);
+                children.emplace_back(new SnapshotMenu(*this, entry.block, std::move(label), aggregate));
+            }
+            children.back()->flags |= MenuComponent::READ_ONLY;
+        }
+        return children;
+    }
+
+    void evict(SnapshotMenu *menu)
+    {
+        static const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const SnapshotBlockRef &ref = blocks[menu->block];
+        uintptr_t first = reinterpret_cast<uintptr_t>(at(ref.offset)) / pageSize * pageSize;
+        uintptr_t last = (reinterpret_cast<uintptr_t>(at(ref.offset + ref.size)) + pageSize - 1) / pageSize * pageSize;
+        madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED);
+        lru.erase(menu->lruPosition);
+        menu->resident = false;
+        residentBytes -= ref.size;
+    }
+
+public:
+    static void write(Menu *root, const std::string &path)
+    {
+        std::vector<Menu *> menus{nullptr};
+        std::vector<std::string> encoded;
+        for (size_t block = 0; block < menus.size(); ++block)
+        {
+            encoded.push_back(encodeBlock(root, menus, block));
+        }
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+        header.version = SNAPSHOT_VERSION;
+        header.blockCount = static_cast<uint32_t>(encoded.size());
+        header.blockTableOffset = align(sizeof(SnapshotHeader), 8);
+        std::vector<SnapshotBlockRef> table(encoded.size());
+        uint64_t offset = header.blockTableOffset + table.size() * sizeof(SnapshotBlockRef);
+        for (size_t block = 0; block < encoded.size(); ++block)
+        {
+            offset = align(offset, SNAPSHOT_BLOCK_ALIGNMENT);
+            table[block] = {offset, encoded[block].size()};
+            offset += encoded[block].size();
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("Cannot open menu snapshot for writing: " + path);
+        }
+        auto writeAt = [&out](uint64_t offset, const void *data, size_t size)
+        {
+            static const char padding[SNAPSHOT_BLOCK_ALIGNMENT] = {};
+            out.write(padding, offset - static_cast<uint64_t>(out.tellp()));
+            out.write(static_cast<const char *>(data), size);
+        };
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.blockTableOffset, table.data(), table.size() * sizeof(SnapshotBlockRef));
+        for (size_t block = 0; block < encoded.size(); ++block)
+        {
+            writeAt(table[block].offset, encoded[block].data(), encoded[block].size());
+        }
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write menu snapshot: " + path);
+        }
+    }
+
+    MenuSnapshot(const std::string &path, size_t residentLimit = 64)
+        : path(path), residentLimit(std::max<size_t>(1, residentLimit))
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot open menu snapshot: " + path);
+        }
+        struct stat status;
+        if (fstat(fd, &status) != 0 || status.st_size == 0)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot read menu snapshot: " + path);
+        }
+        fileSize = static_cast<size_t>(status.st_size);
+        mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("Cannot map menu snapshot: " + path);
+        }
+        try
+        {
+            readIndex();
+        }
+        catch (...)
+        {
+            munmap(mapping, fileSize);
+            throw;
+        }
+    }
+
+    ~MenuSnapshot()
+    {
+        rootMenu.reset();
+        munmap(mapping, fileSize);
+    }
+
+    MenuSnapshot(const MenuSnapshot &) = delete;
+    MenuSnapshot &operator=(const MenuSnapshot &) = delete;
+
+    Menu *root() const { return rootMenu.get(); }
+    size_t menuCount() const { return blocks.size() - 1; }
+
+    size_t residentMenus() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lru.size();
+    }
+
+    size_t residentBlockBytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return residentBytes;
+    }
+
+    // Creates the menu's children on first use and marks its block most
+    // recently used, evicting the least recently used blocks past the limit.
+    void load(SnapshotMenu *menu)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!menu->loaded)
+        {
+            for (auto &child : decode(menu->block))
+            {
+                menu->adopt(child.release());
+            }
+            menu->loaded = true;
+        }
+        if (menu->resident)
+        {
+            lru.splice(lru.begin(), lru, menu->lruPosition);
+            return;
+        }
+        lru.push_front(menu);
+        menu->lruPosition = lru.begin();
+        menu->resident = true;
+        residentBytes += blocks[menu->block].size;
+        while (lru.size() > residentLimit)
+        {
+            evict(lru.back());
+        }
+    }
+};
+
+const Menu::ComponentList &SnapshotMenu::children() const
+{
+    snapshot.load(const_cast<SnapshotMenu *>(this));
+    return Menu::children();
+}
+
+Menu::~Menu()
+{
+    if (pathIndex)
+    {
+        pathIndex->detachRoot();
+    }
+}
+
+VisitResult Menu::accept(MenuVisitor &visitor)
+{
+    struct Frame
+    {
+        const ComponentList *children;
+        size_t next;
+    };
+
+    VisitResult result = visitor.visitMenu(*this);
+    if (result != VisitResult::Continue)
+    {
+        return result == VisitResult::Stop ? VisitResult::Stop : VisitResult::Continue;
+    }
+    std::vector<Frame> stack{{&children(), 0}};
+    while (!stack.empty())
+    {
+        Frame &frame = stack.back();
+        if (frame.next == frame.children->size())
+        {
+            stack.pop_back();
+            continue;
+        }
+        MenuComponent *child = (*frame.children)[frame.next++].get();
+        if (child->getKind() == NodeKind::Item)
+        {
+            if (visitor.visitItem(static_cast<MenuItem &>(*child)) == VisitResult::Stop)
+            {
+                return VisitResult::Stop;
+            }
+            continue;
+        }
+        Menu *menu = static_cast<Menu *>(child);
+        result = visitor.visitMenu(*menu);
+        if (result == VisitResult::Stop)
+        {
+            return VisitResult::Stop;
+        }
+        if (result == VisitResult::Continue)
+        {
+            stack.push_back({&menu->children(), 0});
+        }
+    }
+    return VisitResult::Continue;
+}
+
+void Menu::print() const
+{
+    MenuRendering rendering;
+    render(rendering);
+    rendering.writeTo(std::cout);
+    std::cout.flush();
+}
+
+MenuHandle MenuComponent::getHandle()
+{
+    MenuHandleTable &table = MenuHandleTable::getInstance();
+    if (flags & HAS_HANDLE)
+    {
+        return table.handleOf(this);
+    }
+    if ((flags & IN_ARENA) && getKind() == NodeKind::Item)
+    {
+        MenuArena::of(this)->track(this);
+    }
+    if (flags & IN_ARENA)
+    {
+        MenuArena::of(this)->requireTeardown();
+    }
+    flags |= HAS_HANDLE;
+    return table.acquire(this);
+}
+
+void Menu::adopt(MenuComponent *component)
+{
+    if (component->flags & IN_ARENA)
+    {
+        MenuArena::markAdopted(component);
+    }
+    component->parent = this;
+    component->childIndex = static_cast<uint32_t>(components.size());
+    components.emplace_back(component);
+}
+
+void Menu::addComponent(MenuComponent *component)
+{
+    requireWritable();
+    if (component->parent || (component->flags & READ_ONLY))
+    {
+        throw std::invalid_argument("Component already belongs to a menu");
+    }
+    if (hasIndexedAncestor())
+    {
+        MenuPathIndex::requireIndexableNames(component);
+    }
+    if ((flags & IN_ARENA) && !MenuArena::sameArena(this, component))
+    {
+        MenuArena::of(this)->requireTeardown();
+    }
+    adopt(component);
+    invalidateRender();
+    MenuAggregate delta = component->getAggregate();
+    for (Menu *menu = this; menu; menu = menu->parent)
+    {
+        menu->aggregate.add(delta);
+        if (menu->pathIndex)
+        {
+            menu->pathIndex->addSubtree(component);
+        }
+    }
+}
+
+MenuAggregate Menu::detach(MenuComponent *component)
+{
+    for (Menu *menu = this; menu; menu = menu->parent)
+    {
+        if (menu->pathIndex)
+        {
+            menu->pathIndex->removeSubtree(component);
+        }
+    }
+    return component->getAggregate();
+}
+
+// An arena menu that skipped teardown would never tell its index it is gone.
+void Menu::attachPathIndex(MenuPathIndex *index)
+{
+    if (flags & IN_ARENA)
+    {
+        MenuArena::of(this)->requireTeardown();
+    }
+    pathIndex = index;
+}
+
+void Menu::applyRemoval(const MenuAggregate &removed)
+{
+    invalidateRender();
+    for (Menu *menu = this; menu; menu = menu->parent)
+    {
+        menu->aggregate.subtract(removed);
+        if (menu->aggregate.boundsExhausted())
+        {
+            menu->recomputeBounds();
+        }
+    }
+}
+
+void Menu::applyItemChange(const MenuAggregate &before, const MenuAggregate &after)
+{
+    invalidateRender();
+    for (Menu *menu = this; menu; menu = menu->parent)
+    {
+        menu->aggregate.subtract(before);
+        menu->aggregate.add(after);
+        if (menu->aggregate.boundsExhausted())
+        {
+            menu->recomputeBounds();
+        }
+    }
+}
+
+void MenuItem::setPrice(double newPrice)
+{
+    requireWritable();
+    MenuAggregate before = getAggregate();
+    price = newPrice;
+    if (Menu *menu = getParent())
+    {
+        menu->applyItemChange(before, getAggregate());
+    }
+}
+
+void Menu::removeComponent(MenuComponent *component, ChildOrder order)
+{
+    requireWritable();
+    if (!isChild(component))
+    {
+        return;
+    }
+    MenuAggregate removed = detach(component);
+    size_t index = component->childIndex;
+    if (order == ChildOrder::Unordered)
+    {
+        std::swap(components[index], components.back());
+        components[index]->childIndex = static_cast<uint32_t>(index);
+        components.pop_back();
+    }
+    else
+    {
+        components.erase(components.begin() + index);
+        for (size_t i = index; i < components.size(); ++i)
+        {
+            components[i]->childIndex = static_cast<uint32_t>(i);
+        }
+    }
+    applyRemoval(removed);
+}
+
+bool Menu::removeComponent(MenuHandle handle, ChildOrder order)
+{
+    MenuComponent *component = MenuHandleTable::getInstance().resolve(handle);
+    if (!isChild(component))
+    {
+        return false;
+    }
+    removeComponent(component, order);
+    return true;
+}
+
+void Menu::removeComponents(const std::vector<MenuComponent *> &removed, ChildOrder order)
+{
+    requireWritable();
+    MenuAggregate total;
+    std::vector<ComponentList::value_type> unlinked;
+    for (MenuComponent *component : removed)
+    {
+        if (!isChild(component))
+            continue;
+        total.add(detach(component));
+        size_t index = component->childIndex;
+        unlinked.push_back(std::move(components[index]));
+        if (order == ChildOrder::Unordered)
+        {
+            if (index != components.size() - 1)
+            {
+                components[index] = std::move(components.back());
+                components[index]->childIndex = static_cast<uint32_t>(index);
+            }
+            components.pop_back();
+        }
+    }
+    if (order == ChildOrder::Preserve)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < components.size(); ++i)
+        {
+            if (components[i])
+            {
+                components[i]->childIndex = static_cast<uint32_t>(kept);
+                components[kept++] = std::move(components[i]);
+            }
+        }
+        components.resize(kept);
+    }
+    applyRemoval(total);
+}
+
+std::shared_ptr<const RenderedMenu> Menu::buildRender(const std::ostream &format) const
+{
+    if (flags & IN_ARENA)
+    {
+        MenuArena::of(this)->requireTeardown();
+    }
+    auto cache = std::make_shared<RenderedMenu>();
+    cache->flags = format.flags();
+    cache->precision = format.precision();
+    cache->locale = format.getloc();
+    std::ostringstream text;
+    text.flags(cache->flags);
+    text.precision(cache->precision);
+    text.imbue(cache->locale);
+    text << "\n"
+         << getName() << ", " << getDescription() << "\n---------------------\n";
+    for (const auto &component : children())
+    {
+        if (component->getKind() == NodeKind::Menu)
+        {
+            cache->runs.push_back(text.str());
+            text.str(std::string());
+            cache->submenus.push_back(static_cast<const Menu *>(component.get()));
+        }
+        else
+        {
+            static_cast<const MenuItem *>(component.get())->render(text);
+        }
+    }
+    cache->runs.push_back(text.str());
+    return cache;
+}
+
+void Menu::render(MenuRendering &out, const std::ostream &format) const
+{
+    std::shared_ptr<const RenderedMenu> cache = std::atomic_load(&rendered);
+    if (!cache || !cache->formatsLike(format))
+    {
+        cache = buildRender(format);
+        std::atomic_store(&rendered, cache);
+        for (const std::string &run : cache->runs)
+        {
+            out.formatted += run.size();
+        }
+    }
+    out.segments.push_back(cache->runs.front());
+    for (size_t i = 0; i < cache->submenus.size(); ++i)
+    {
+        cache->submenus[i]->render(out, format);
+        if (!cache->runs[i + 1].empty())
+        {
+            out.segments.push_back(cache->runs[i + 1]);
+        }
+    }
+    out.caches.push_back(std::move(cache));
+}
+
+template <typename Predicate, typename Action>
+class ItemQueryVisitor : public MenuVisitor
+{
+    Predicate predicate;
+    Action action;
+
+public:
+    ItemQueryVisitor(Predicate predicate, Action action) : predicate(predicate), action(action) {}
+
+    VisitResult visitItem(MenuItem &item) override
+    {
+        if (predicate(item) && !action(item))
+        {
+            return VisitResult::Stop;
+        }
+        return VisitResult::Continue;
+    }
+};
+
+template <typename Predicate, typename Action>
+void forEachItem(MenuComponent *root, Predicate predicate, Action action)
+{
+    auto visit = [&action](MenuItem &item)
+    {
+        action(item);
+        return true;
+    };
+    ItemQueryVisitor<Predicate, decltype(visit)> visitor(predicate, visit);
+    root->accept(visitor);
+}
+
+template <typename Predicate>
+MenuItem *findItem(MenuComponent *root, Predicate predicate)
+{
+    MenuItem *found = nullptr;
+    auto stop = [&found](MenuItem &item)
+    {
+        found = &item;
+        return false;
+    };
+    ItemQueryVisitor<Predicate, decltype(stop)> visitor(predicate, stop);
+    root->accept(visitor);
+    return found;
+}
+
+// Name and description are ids into the owning FrozenMenu's text arena.
+struct FrozenNode
+{
+    uint32_t name;
+    uint32_t description;
+    double price;
+    uint32_t subtreeEnd;
+    NodeKind kind;
+    bool vegetarian;
+};
+
+class FrozenMenu
+{
+    std::vector<FrozenNode> nodes;
+    TextArena strings;
+
+    struct Frame
+    {
+        Menu *menu;
+        int nextChild;
+        size_t node;
+    };
+
+    void append(MenuComponent *component, std::vector<Frame> &stack)
+    {
+        FrozenNode node{};
+        node.name = strings.intern(component->getName());
+        node.description = strings.intern(component->getDescription());
+        node.subtreeEnd = static_cast<uint32_t>(nodes.size() + 1);
+        if (component->getKind() == NodeKind::Menu)
+        {
+            node.kind = NodeKind::Menu;
+            stack.push_back({static_cast<Menu *>(component), 0, nodes.size()});
+        }
+        else
+        {
+            node.kind = NodeKind::Item;
+            node.vegetarian = component->isVegetarian();
+            node.price = component->getPrice();
+        }
+        nodes.push_back(node);
+    }
+
+public:
+    FrozenMenu(MenuComponent *root)
+    {
+        std::vector<Frame> stack;
+        append(root, stack);
+        while (!stack.empty())
+        {
+            Frame &frame = stack.back();
+            if (frame.nextChild < frame.menu->getNumberOfChildren())
+            {
+                append(frame.menu->getChild(frame.nextChild++), stack);
+            }
+            else
+            {
+                nodes[frame.node].subtreeEnd = static_cast<uint32_t>(nodes.size());
+                stack.pop_back();
+            }
+        }
+    }
+
+    size_t size() const { return nodes.size(); }
+    const FrozenNode &getNode(size_t index) const { return nodes.at(index); }
+    std::string_view text(uint32_t id) const { return strings.view(id); }
+
+    template <typename Visit>
+    void forEachInSubtree(size_t root, Visit visit) const
+    {
+        for (size_t index = root, end = nodes.at(root).subtreeEnd; index < end; ++index)
+        {
+            visit(nodes[index]);
+        }
+    }
+
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        if (!nodes.empty())
+        {
+            forEachInSubtree(0, visit);
+        }
+    }
+
+    void print(const FrozenNode &node) const
+    {
+        if (node.kind == NodeKind::Menu)
+        {
+            std::cout << std::endl
+                      << text(node.name) << ", " << text(node.description) << std::endl;
+            std::cout << "---------------------" << std::endl;
+            return;
+        }
+        std::cout << "  " << text(node.name);
+        if (node.vegetarian)
+        {
+            std::cout << " (v)";
+        }
+        std::cout << ", " << node.price << std::endl;
+        std::cout << "     -- " << text(node.description) << std::endl;
+    }
+
+    void print() const
+    {
+        forEach([this](const FrozenNode &node)
+                { print(node); });
+    }
+
+    void printVegetarian() const
+    {
+        forEach([this](const FrozenNode &node)
+                {
+                    if (node.kind == NodeKind::Item && node.vegetarian)
+                        print(node); });
+    }
+};
+
+class WorkStealingPool
+{
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+    // Idle workers sleep on `idle` until work is queued or the pool stops.
+    // `stopping` and increments of `queued` happen under idleMutex, so a
+    // wakeup cannot slip in between a worker's check and its wait.
+    bool stopping = false;
+    std::mutex idleMutex;
+    std::condition_variable idle;
+
+    static thread_local const WorkStealingPool *currentPool;
+    static thread_local size_t currentQueue;
+
+    size_t ownQueue() const
+    {
+        return currentPool == this ? currentQueue : queues.size() - 1;
+    }
+
+    bool popOwn(size_t self, std::function<void()> &task)
+    {
+        TaskQueue &queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(size_t self, std::function<void()> &task)
+    {
+        for (size_t offset = 1; offset < queues.size(); ++offset)
+        {
+            TaskQueue &victim = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void work(size_t self)
+    {
+        currentPool = this;
+        currentQueue = self;
+        while (true)
+        {
+            if (runOne())
+            {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(idleMutex);
+            idle.wait(lock, [this]
+                      { return stopping || queued > 0; });
+            if (stopping)
+            {
+                return;
+            }
+        }
+    }
+
+public:
+    explicit WorkStealingPool(size_t threads)
+    {
+        for (size_t i = 0; i <= threads; ++i)
+        {
+            queues.push_back(std::make_unique<TaskQueue>());
+        }
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back(&WorkStealingPool::work, this, i);
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(idleMutex);
+            stopping = true;
+            idle.notify_all();
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    void push(std::function<void()> task)
+    {
+        TaskQueue &queue = *queues[ownQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        std::lock_guard<std::mutex> lock(idleMutex);
+        ++queued;
+        idle.notify_one();
+    }
+
+    bool hasQueued() const
+    {
+        return queued > 0;
+    }
+
+    bool runOne()
+    {
+        size_t self = ownQueue();
+        std::function<void()> task;
+        if (!popOwn(self, task) && !steal(self, task))
+        {
+            return false;
+        }
+        --queued;
+        task();
+        return true;
+    }
+};
+
+thread_local const WorkStealingPool *WorkStealingPool::currentPool = nullptr;
+thread_local size_t WorkStealingPool::currentQueue = 0;
+
+class TaskGroup
+{
+    WorkStealingPool &pool;
+    std::atomic<size_t> pending{0};
+    std::mutex doneMutex;
+    std::condition_variable done;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+
+public:
+    TaskGroup(WorkStealingPool &pool) : pool(pool) {}
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    template <typename Task>
+    void run(Task task)
+    {
+        ++pending;
+        pool.push([this, task]
+                  {
+                      try
+                      {
+                          task();
+                      }
+                      catch (...)
+                      {
+                          std::lock_guard<std::mutex> lock(errorMutex);
+                          if (!error)
+                              error = std::current_exception();
+                      }
+                      std::lock_guard<std::mutex> lock(doneMutex);
+                      if (--pending == 0)
+                          done.notify_all(); });
+    }
+
+    ~TaskGroup()
+    {
+        drain();
+    }
+
+    void drain()
+    {
+        while (pending > 0)
+        {
+            if (pool.runOne())
+            {
+                continue;
+            }
+            // Everything left is running elsewhere; sleep until a task of
+            // this group finishes or more work is queued.
+            std::unique_lock<std::mutex> lock(doneMutex);
+            done.wait(lock, [this]
+                      { return pending == 0 || pool.hasQueued(); });
+        }
+        // The last task decrements `pending` and notifies under doneMutex;
+        // taking it once more keeps the group alive until that returns.
+        std::lock_guard<std::mutex> lock(doneMutex);
+    }
+
+    void wait()
+    {
+        drain();
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+template <typename T, typename Accumulate>
+void accumulateItems(MenuComponent *root, T &partial, const Accumulate &accumulate)
+{
+    forEachItem(
+        root, [](const MenuItem &)
+        { return true; },
+        [&](MenuItem &item)
+        { accumulate(partial, item); });
+}
+
+template <typename T, typename Accumulate, typename Combine>
+T parallelReduce(WorkStealingPool &pool, MenuComponent *root, const T &identity,
+                 const Accumulate &accumulate, const Combine &combine, size_t grainSize)
+{
+    T result = identity;
+    auto accumulateAll = [&accumulate](MenuComponent *component, T &partial)
+    {
+        accumulateItems(component, partial, accumulate);
+    };
+    if (root->getKind() == NodeKind::Item || root->getAggregate().itemCount <= grainSize)
+    {
+        accumulateAll(root, result);
+        return result;
+    }
+
+    Menu *menu = static_cast<Menu *>(root);
+    std::vector<MenuComponent *> children(menu->getNumberOfChildren());
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        children[i] = menu->getChild(static_cast<int>(i));
+    }
+
+    std::deque<T> partials;
+    TaskGroup group(pool);
+    for (size_t first = 0; first < children.size();)
+    {
+        T &partial = partials.emplace_back(identity);
+        if (children[first]->getAggregate().itemCount > grainSize)
+        {
+            MenuComponent *child = children[first++];
+            group.run([&pool, child, &partial, &identity, &accumulate, &combine, grainSize]
+                      { partial = parallelReduce(pool, child, identity, accumulate, combine, grainSize); });
+            continue;
+        }
+        size_t last = first;
+        size_t items = 0;
+        while (last < children.size() && items + children[last]->getAggregate().itemCount <= grainSize)
+        {
+            items += children[last++]->getAggregate().itemCount;
+        }
+        group.run([&children, first, last, &partial, &accumulateAll]
+                  {
+                      for (size_t i = first; i < last; ++i)
+                      {
+                          accumulateAll(children[i], partial);
+                      } });
+        first = last;
+    }
+    group.wait();
+    for (T &partial : partials)
+    {
+        combine(result, std::move(partial));
+    }
+    return result;
+}
+
+// Name and description view text owned by the PersistentMenu that made the node.
+struct PersistentMenuNode
+{
+    NodeKind kind;
+    std::string_view name;
+    std::string_view description;
+    bool vegetarian = false;
+    double price = 0;
+    std::vector<std::shared_ptr<const PersistentMenuNode>> children;
+};
+
+// Edits copy the path from the root to the edited menu and publish the new
+// root with std::atomic_store; readers take it with std::atomic_load and keep
+// that version alive for as long as they hold it. Child names are unique
+// within a menu, so a path names at most one node.
+class PersistentMenu
+{
+public:
+    typedef std::shared_ptr<const PersistentMenuNode> NodePtr;
+
+private:
+    TextArena text;
+    std::mutex textMutex;
+    NodePtr root;
+    std::mutex writerMutex;
+
+    static std::vector<std::string_view> splitPath(std::string_view path)
+    {
+        std::vector<std::string_view> names;
+        size_t start = 0;
+        while (true)
+        {
+            size_t slash = path.find('/', start);
+            names.push_back(path.substr(start, slash - start));
+            if (slash == std::string_view::npos)
+                return names;
+            start = slash + 1;
+        }
+    }
+
+    static int findChild(const PersistentMenuNode &menu, std::string_view name)
+    {
+        for (size_t i = 0; i < menu.children.size(); ++i)
+        {
+            if (menu.children[i]->name == name)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    template <typename Edit>
+    static NodePtr copyPath(const NodePtr &node, const std::vector<std::string_view> &names, size_t depth, Edit &edit)
+    {
+        if (depth == names.size())
+        {
+            if (node->kind != NodeKind::Menu)
+                return nullptr;
+            auto copy = std::make_shared<PersistentMenuNode>(*node);
+            return edit(*copy) ? copy : nullptr;
+        }
+        int child = findChild(*node, names[depth]);
+        if (child < 0)
+            return nullptr;
+        NodePtr replacement = copyPath(node->children[child], names, depth + 1, edit);
+        if (!replacement)
+            return nullptr;
+        auto copy = std::make_shared<PersistentMenuNode>(*node);
+        copy->children[child] = std::move(replacement);
+        return copy;
+    }
+
+    template <typename Edit>
+    bool editMenu(std::string_view menuPath, Edit edit)
+    {
+        std::vector<std::string_view> names = splitPath(menuPath);
+        std::lock_guard<std::mutex> lock(writerMutex);
+        NodePtr current = std::atomic_load(&root);
+        if (current->name != names.front())
+            return false;
+        NodePtr edited = copyPath(current, names, 1, edit);
+        if (!edited)
+            return false;
+        std::atomic_store(&root, std::move(edited));
+        return true;
+    }
+
+    static std::pair<std::string_view, std::string_view> splitParent(std::string_view path)
+    {
+        size_t slash = path.rfind('/');
+        if (slash == std::string_view::npos)
+            return {std::string_view(), path};
+        return {path.substr(0, slash), path.substr(slash + 1)};
+    }
+
+public:
+    class Snapshot
+    {
+        NodePtr version;
+
+    public:
+        Snapshot(const PersistentMenu &menu) : version(std::atomic_load(&menu.root)) {}
+        const PersistentMenuNode &root() const { return *version; }
+    };
+
+    NodePtr makeItem(std::string_view name, std::string_view description, bool vegetarian, double price)
+    {
+        std::lock_guard<std::mutex> lock(textMutex);
+        return std::make_shared<const PersistentMenuNode>(
+            PersistentMenuNode{NodeKind::Item, text.internView(name), text.internView(description), vegetarian, price, {}});
+    }
+
+    NodePtr makeMenu(std::string_view name, std::string_view description, std::vector<NodePtr> children = {})
+    {
+        std::unordered_set<std::string_view> names;
+        for (const NodePtr &child : children)
+        {
+            if (!names.insert(child->name).second)
+            {
+                throw std::invalid_argument("Duplicate child name in persistent menu: " + std::string(child->name));
+            }
+        }
+        std::lock_guard<std::mutex> lock(textMutex);
+        return std::make_shared<const PersistentMenuNode>(
+            PersistentMenuNode{NodeKind::Menu, text.internView(name), text.internView(description), false, 0, std::move(children)});
+    }
+
+    NodePtr fromComponent(MenuComponent *component)
+    {
+        if (component->getKind() == NodeKind::Item)
+        {
+            return makeItem(component->getName(), component->getDescription(), component->isVegetarian(), component->getPrice());
+        }
+        Menu *menu = static_cast<Menu *>(component);
+        std::vector<NodePtr> children;
+        for (int i = 0; i < menu->getNumberOfChildren(); ++i)
+        {
+            children.push_back(fromComponent(menu->getChild(i)));
+        }
+        return makeMenu(menu->getName(), menu->getDescription(), std::move(children));
+    }
+
+    explicit PersistentMenu(MenuComponent *root) : root(fromComponent(root)) {}
+
+    // Fails if the menu is missing or already has a child with that name.
+    bool addComponent(std::string_view menuPath, NodePtr component)
+    {
+        return editMenu(menuPath, [&component](PersistentMenuNode &menu)
+                        {
+                            if (findChild(menu, component->name) >= 0)
+                                return false;
+                            menu.children.push_back(component);
+                            return true; });
+    }
+
+    bool removeComponent(std::string_view path)
+    {
+        auto [menuPath, name] = splitParent(path);
+        return editMenu(menuPath, [name](PersistentMenuNode &menu)
+                        {
+                            int child = findChild(menu, name);
+                            if (child < 0)
+                                return false;
+                            menu.children.erase(menu.children.begin() + child);
+                            return true; });
+    }
+
+    bool replaceComponent(std::string_view path, NodePtr replacement)
+    {
+        auto [menuPath, name] = splitParent(path);
+        return editMenu(menuPath, [name, &replacement](PersistentMenuNode &menu)
+                        {
+                            int child = findChild(menu, name);
+                            if (child < 0)
+                                return false;
+                            int clash = findChild(menu, replacement->name);
+                            if (clash >= 0 && clash != child)
+                                return false;
+                            menu.children[child] = replacement;
+                            return true; });
+    }
+
+    template <typename Visit>
+    static void forEachItem(const PersistentMenuNode &node, Visit &&visit)
+    {
+        if (node.kind == NodeKind::Item)
+        {
+            visit(node);
+            return;
+        }
+        for (const NodePtr &child : node.children)
+        {
+            forEachItem(*child, visit);
+        }
+    }
+};
+
+class Waitress
+{
+    MenuComponent *menus;
+    size_t threads;
+    std::unique_ptr<WorkStealingPool> pool;
+    std::once_flag poolStarted;
+
+    static const size_t PARALLEL_GRAIN_SIZE = 4096;
+
+    // Worker threads start on the first reduction large enough to use them.
+    WorkStealingPool &getPool()
+    {
+        std::call_once(poolStarted, [this]
+                       { pool = std::make_unique<WorkStealingPool>(threads); });
+        return *pool;
+    }
+
+public:
+    Waitress(MenuComponent *menus, size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+        : menus(menus), threads(threads) {}
+    void printMenu() const
+    {
+        menus->print();
+    }
+
+    void printVegetarianMenu()
+    {
+        forEachItem(
+            menus, [](const MenuItem &item)
+            { return item.isVegetarian(); },
+            [](const MenuItem &item)
+            { item.print(); });
+    }
+
+    bool isItemVegetarian(std::string_view name)
+    {
+        MenuItem *item = findItem(menus, [name](const MenuItem &item)
+                                  { return item.getName() == name; });
+        return item && item->isVegetarian();
+    }
+
+    template <typename T, typename Accumulate, typename Combine>
+    T reduceItems(const T &identity, Accumulate accumulate, Combine combine)
+    {
+        if (menus->getKind() == NodeKind::Item || menus->getAggregate().itemCount <= PARALLEL_GRAIN_SIZE)
+        {
+            T result = identity;
+            accumulateItems(menus, result, accumulate);
+            return result;
+        }
+        return parallelReduce(getPool(), menus, identity, accumulate, combine, PARALLEL_GRAIN_SIZE);
+    }
+
+    template <typename Predicate>
+    size_t countItems(Predicate predicate)
+    {
+        return reduceItems(
+            size_t(0), [&predicate](size_t &count, const MenuItem &item)
+            { count += predicate(item) ? 1 : 0; },
+            [](size_t &count, size_t partial)
+            { count += partial; });
+    }
+
+    template <typename Predicate>
+    double sumPrices(Predicate predicate)
+    {
+        return reduceItems(
+            0.0, [&predicate](double &sum, const MenuItem &item)
+            {
+                if (predicate(item))
+                    sum += item.getPrice(); },
+            [](double &sum, double partial)
+            { sum += partial; });
+    }
+
+    template <typename Predicate>
+    std::vector<MenuItem *> filterItems(Predicate predicate)
+    {
+        return reduceItems(
+            std::vector<MenuItem *>(), [&predicate](std::vector<MenuItem *> &items, MenuItem &item)
+            {
+                if (predicate(item))
+                    items.push_back(&item); },
+            [](std::vector<MenuItem *> &items, std::vector<MenuItem *> partial)
+            { items.insert(items.end(), partial.begin(), partial.end()); });
+    }
+};
+
+// Applies seeded random adds, removals and price edits, then compares every
+// menu's cached aggregate with a brute-force walk of its subtree.
+bool aggregatesMatchBruteForce(unsigned seed, int edits)
+{
+    std::mt19937 random(seed);
+    auto pick = [&random](size_t count)
+    {
+        return std::uniform_int_distribution<size_t>(0, count - 1)(random);
+    };
+    std::unique_ptr<Menu> root(new Menu("Audit", "Randomized aggregate check"));
+    std::vector<Menu *> menus;
+    std::vector<MenuItem *> items;
+    auto collect = [&]
+    {
+        menus.assign(1, root.get());
+        items.clear();
+        for (size_t i = 0; i < menus.size(); ++i)
+        {
+            for (int child = 0; child < menus[i]->getNumberOfChildren(); ++child)
+            {
+                MenuComponent *component = menus[i]->getChild(child);
+                if (component->getKind() == NodeKind::Menu)
+                    menus.push_back(static_cast<Menu *>(component));
+                else
+                    items.push_back(static_cast<MenuItem *>(component));
+            }
+        }
+    };
+    auto randomPrice = [&]
+    {
+        return std::uniform_int_distribution<int>(1, 2000)(random) / 100.0;
+    };
+
+    collect();
+    for (int edit = 0; edit < edits; ++edit)
+    {
+        Menu *menu = menus[pick(menus.size())];
+        switch (pick(6))
+        {
+        case 0:
+            menu->addComponent(new Menu("Submenu", ""));
+            break;
+        case 1:
+        case 2:
+            menu->addComponent(new MenuItem("Item", "", pick(2) == 0, randomPrice()));
+            break;
+        case 3:
+        case 4:
+            if (!items.empty())
+                items[pick(items.size())]->setPrice(randomPrice());
+            break;
+        default:
+            if (menu->getNumberOfChildren() > 0)
+                menu->removeComponent(menu->getChild(static_cast<int>(pick(menu->getNumberOfChildren()))),
+                                      pick(2) == 0 ? ChildOrder::Preserve : ChildOrder::Unordered);
+            break;
+        }
+        collect();
+    }
+
+    for (Menu *menu : menus)
+    {
+        MenuAggregate expected;
+        forEachItem(
+            menu, [](const MenuItem &)
+            { return true; },
+            [&expected](const MenuItem &item)
+            { expected.add(item.getAggregate()); });
+        MenuAggregate cached = menu->getAggregate();
+        if (cached.itemCount != expected.itemCount || cached.vegetarianCount != expected.vegetarianCount ||
+            cached.priceSumCents != expected.priceSumCents || cached.priceMin != expected.priceMin ||
+            cached.priceMax != expected.priceMax || cached.atPriceMin != expected.atPriceMin ||
+            cached.atPriceMax != expected.atPriceMax)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Applies seeded single and bulk removals by handle and pointer, in both
+// child orders, and checks the menu against a plain vector doing the same.
+bool handleRemovalsMatchModel(unsigned seed, int operations)
+{
+    std::mt19937 random(seed);
+    auto pick = [&random](size_t count)
+    {
+        return std::uniform_int_distribution<size_t>(0, count - 1)(random);
+    };
+    Menu menu("Audit", "Randomized removal check");
+    std::vector<MenuComponent *> model;
+    std::vector<MenuHandle> removedHandles;
+    MenuHandleTable &table = MenuHandleTable::getInstance();
+    auto removeFromModel = [&model](MenuComponent *component, ChildOrder order)
+    {
+        auto it = std::find(model.begin(), model.end(), component);
+        if (order == ChildOrder::Preserve)
+        {
+            model.erase(it);
+            return;
+        }
+        *it = model.back();
+        model.pop_back();
+    };
+
+    for (int operation = 0; operation < operations; ++operation)
+    {
+        ChildOrder order = pick(2) == 0 ? ChildOrder::Preserve : ChildOrder::Unordered;
+        size_t choice = model.empty() ? 0 : pick(4);
+        if (choice == 0)
+        {
+            for (size_t added = pick(8) + 1; added > 0; --added)
+            {
+                MenuItem *item = new MenuItem("Item", "", true, 1.00);
+                menu.addComponent(item);
+                model.push_back(item);
+            }
+        }
+        else if (choice == 1)
+        {
+            MenuComponent *component = model[pick(model.size())];
+            MenuHandle handle = component->getHandle();
+            removeFromModel(component, order);
+            if (!menu.removeComponent(handle, order))
+                return false;
+            removedHandles.push_back(handle);
+        }
+        else if (choice == 2)
+        {
+            MenuComponent *component = model[pick(model.size())];
+            removedHandles.push_back(component->getHandle());
+            removeFromModel(component, order);
+            menu.removeComponent(component, order);
+        }
+        else
+        {
+            std::vector<MenuComponent *> removed;
+            for (MenuComponent *component : model)
+            {
+                if (pick(4) == 0)
+                    removed.push_back(component);
+            }
+            std::shuffle(removed.begin(), removed.end(), random);
+            for (MenuComponent *component : removed)
+            {
+                removedHandles.push_back(component->getHandle());
+                removeFromModel(component, order);
+            }
+            menu.removeComponents(removed, order);
+        }
+
+        if (menu.getNumberOfChildren() != static_cast<int>(model.size()))
+            return false;
+        for (size_t i = 0; i < model.size(); ++i)
+        {
+            if (menu.getChild(static_cast<int>(i)) != model[i])
+                return false;
+        }
+    }
+    for (MenuHandle handle : removedHandles)
+    {
+        if (table.resolve(handle) || menu.removeComponent(handle))
+            return false;
+    }
+    return true;
+}
+
+std::atomic<size_t> allocationCount{0};
+
+// All replacements stay out of line so that GCC does not see malloc and free
+// through them and warn that new and delete are mismatched.
+[[gnu::noinline]] void *operator new(size_t size)
+{
+    ++allocationCount;
+    if (void *memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void *operator new(size_t size, std::align_val_t alignment)
+{
+    ++allocationCount;
+    size_t align = static_cast<size_t>(alignment);
+    if (void *memory = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+        return memory;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    ++allocationCount;
+    return std::malloc(size ? size : 1);
+}
+
+[[gnu::noinline]] void operator delete(void *memory) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+
+struct BenchmarkRun
+{
+    double seconds;
+    size_t allocations;
+};
+
+template <typename F>
+BenchmarkRun measure(F &&work)
+{
+    size_t allocations = allocationCount.load();
+    auto begin = std::chrono::steady_clock::now();
+    work();
+    return BenchmarkRun{std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(),
+                        allocationCount.load() - allocations};
+}
+
+// Grows `root` to about `nodes` components breadth first. Every menu gets
+// `fanout` children, the first `submenus` of which are menus themselves.
+template <typename MakeMenu, typename MakeItem>
+void fillBenchmarkMenu(Menu *root, size_t nodes, size_t fanout, size_t submenus, MakeMenu makeMenu, MakeItem makeItem)
+{
+    std::deque<Menu *> open{root};
+    size_t built = 1;
+    while (built < nodes && !open.empty())
+    {
+        Menu *menu = open.front();
+        open.pop_front();
+        for (size_t i = 0; i < fanout && built < nodes; ++i, ++built)
+        {
+            if (i < submenus)
+            {
+                Menu *submenu = makeMenu("menu " + std::to_string(built), "house menu");
+                menu->addComponent(submenu);
+                open.push_back(submenu);
+            }
+            else
+            {
+                menu->addComponent(makeItem("dish " + std::to_string(built), "house special",
+                                            built % 3 == 0, 1.0 + built % 500 / 10.0));
+            }
+        }
+    }
+}
+
+std::unique_ptr<Menu> buildBenchmarkMenu(size_t nodes, size_t fanout, size_t submenus)
+{
+    auto root = std::make_unique<Menu>("All Menus", "All menus combined");
+    fillBenchmarkMenu(
+        root.get(), nodes, fanout, submenus, [](const std::string &name, const char *description)
+        { return new Menu(name, description); },
+        [](const std::string &name, const char *description, bool vegetarian, double price)
+        { return new MenuItem(name, description, vegetarian, price); });
+    return root;
+}
+
+void benchmarkFrozen(size_t nodes)
+{
+    std::unique_ptr<Menu> menu = buildBenchmarkMenu(nodes, 16, 2);
+    std::unique_ptr<FrozenMenu> frozen;
+    BenchmarkRun freeze = measure([&]
+                                  { frozen = std::make_unique<FrozenMenu>(menu.get()); });
+
+    auto report = [](const char *walk, const BenchmarkRun &run, size_t visited, double priceSum)
+    {
+        std::cout << "  " << walk << ": " << visited / run.seconds / 1e6 << "M nodes/s, "
+                  << run.allocations << " allocations, price sum " << priceSum << "\n";
+    };
+    std::cout << "frozen: " << frozen->size() << " nodes, fan-out 16\n"
+              << "  freeze: " << freeze.seconds << " s\n";
+
+    size_t visited = 0;
+    double priceSum = 0;
+    auto iterate = [&](Menu *root)
+    {
+        return measure([&]
+                       {
+                           visited = 1;
+                           priceSum = 0;
+                           std::unique_ptr<Iterator> iterator(root->createIterator());
+                           while (iterator->hasNext())
+                           {
+                               MenuComponent *component = static_cast<MenuComponent *>(iterator->next());
+                               ++visited;
+                               if (component->getKind() == NodeKind::Item)
+                                   priceSum += component->getPrice();
+                           } });
+    };
+    auto scan = [&](size_t root)
+    {
+        return measure([&]
+                       {
+                           visited = 0;
+                           priceSum = 0;
+                           frozen->forEachInSubtree(root, [&](const FrozenNode &node)
+                                                    {
+                                                        ++visited;
+                                                        if (node.kind == NodeKind::Item)
+                                                            priceSum += node.price; }); });
+    };
+
+    BenchmarkRun full = iterate(menu.get());
+    report("CompositeIterator, whole tree", full, visited, priceSum);
+    full = scan(0);
+    report("FrozenMenu scan, whole tree", full, visited, priceSum);
+    // The first submenu is frozen right after the root.
+    BenchmarkRun subtree = iterate(static_cast<Menu *>(menu->getChild(0)));
+    report("CompositeIterator, first submenu", subtree, visited, priceSum);
+    subtree = scan(1);
+    report("FrozenMenu scan, first submenu", subtree, visited, priceSum);
+}
+
+// A spine of `depth` nested menus, each level also holding side menus of
+// four items. Built from the bottom up, so every add updates one detached
+// menu instead of the whole chain above it.
+std::unique_ptr<Menu> buildDeepMenu(size_t nodes, size_t depth)
+{
+    size_t perLevel = std::max<size_t>(5, nodes / depth);
+    std::unique_ptr<Menu> below;
+    size_t built = 0;
+    for (size_t level = depth; level-- > 0;)
+    {
+        auto menu = std::make_unique<Menu>(level ? "menu " + std::to_string(level) : "All Menus", "house menu");
+        for (size_t side = 5; side <= perLevel; side += 5)
+        {
+            Menu *sideMenu = new Menu("side " + std::to_string(built++), "side menu");
+            for (int i = 0; i < 4; ++i, ++built)
+            {
+                sideMenu->addComponent(new MenuItem("dish " + std::to_string(built), "house special",
+                                                    built % 3 == 0, 1.0 + built % 500 / 10.0));
+            }
+            menu->addComponent(sideMenu);
+        }
+        if (below)
+        {
+            menu->addComponent(below.release());
+        }
+        below = std::move(menu);
+    }
+    return below;
+}
+
+void benchmarkVegetarian(size_t nodes)
+{
+    const size_t DEPTH = 1000;
+    const size_t QUERIES = 5;
+    std::unique_ptr<Menu> menu = buildDeepMenu(nodes, DEPTH);
+    size_t menus = 0;
+
+    // What printVegetarianMenu did before the visitor: ask every node and
+    // treat the exception a menu throws as "not an item".
+    size_t vegetarian = 0;
+    BenchmarkRun throwing = measure([&]
+                                    {
+                                        for (size_t q = 0; q < QUERIES; ++q)
+                                        {
+                                            vegetarian = 0;
+                                            menus = 0;
+                                            std::unique_ptr<Iterator> iterator(menu->createIterator());
+                                            while (iterator->hasNext())
+                                            {
+                                                MenuComponent *component = static_cast<MenuComponent *>(iterator->next());
+                                                try
+                                                {
+                                                    vegetarian += component->isVegetarian();
+                                                }
+                                                catch (const std::runtime_error &)
+                                                {
+                                                    ++menus;
+                                                }
+                                            }
+                                        } });
+    size_t throwingVegetarian = vegetarian;
+
+    BenchmarkRun visited = measure([&]
+                                   {
+                                       for (size_t q = 0; q < QUERIES; ++q)
+                                       {
+                                           vegetarian = 0;
+                                           forEachItem(
+                                               menu.get(), [](const MenuItem &item)
+                                               { return item.isVegetarian(); },
+                                               [&vegetarian](MenuItem &)
+                                               { ++vegetarian; });
+                                       } });
+
+    std::cout << "vegetarian: " << menu->getAggregate().itemCount << " items, " << menus << " submenus, depth " << DEPTH << "\n"
+              << "  iterator catching exceptions: " << throwing.seconds * 1e3 / QUERIES << " ms per query, "
+              << throwingVegetarian << " vegetarian\n"
+              << "  visitor: " << visited.seconds * 1e3 / QUERIES << " ms per query, " << vegetarian << " vegetarian\n"
+              << "  difference: " << (throwing.seconds - visited.seconds) * 1e9 / QUERIES / menus
+              << " ns per submenu\n";
+}
+
+void benchmarkAggregates(size_t nodes)
+{
+    const size_t OPERATIONS = 1000000;
+    const size_t WALKED_OPERATIONS = 500;
+    // Queries ask about the menus near the top, like "Diner" or "Dessert
+    // Menu", whose subtrees a walk has to cover.
+    const size_t QUERIED_MENUS = 64;
+    std::unique_ptr<Menu> root = buildBenchmarkMenu(nodes, 16, 2);
+    std::vector<Menu *> menus{root.get()};
+    std::vector<MenuItem *> items;
+    for (size_t i = 0; i < menus.size(); ++i)
+    {
+        for (int child = 0; child < menus[i]->getNumberOfChildren(); ++child)
+        {
+            MenuComponent *component = menus[i]->getChild(child);
+            if (component->getKind() == NodeKind::Menu)
+                menus.push_back(static_cast<Menu *>(component));
+            else
+                items.push_back(static_cast<MenuItem *>(component));
+        }
+    }
+
+    std::mt19937 random(7);
+    auto pick = [&random](size_t count)
+    {
+        return std::uniform_int_distribution<size_t>(0, count - 1)(random);
+    };
+    std::vector<MenuItem *> added;
+    // One update in three adds or removes an item, the rest change a price.
+    auto update = [&]
+    {
+        size_t kind = pick(6);
+        if (kind == 0 || (kind == 1 && added.empty()))
+        {
+            Menu *menu = menus[pick(menus.size())];
+            added.push_back(new MenuItem("special", "added", pick(2) == 0, 1.0 + pick(500) / 10.0));
+            menu->addComponent(added.back());
+        }
+        else if (kind == 1)
+        {
+            added.back()->getParent()->removeComponent(added.back(), ChildOrder::Unordered);
+            added.pop_back();
+        }
+        else
+        {
+            items[pick(items.size())]->setPrice(1.0 + pick(500) / 10.0);
+        }
+    };
+    double checksum = 0;
+    auto cachedQuery = [&]
+    {
+        MenuAggregate aggregate = menus[pick(QUERIED_MENUS)]->getAggregate();
+        checksum += aggregate.vegetarianCount + aggregate.averagePrice();
+    };
+    auto walkedQuery = [&]
+    {
+        MenuAggregate aggregate;
+        forEachItem(
+            menus[pick(QUERIED_MENUS)], [](const MenuItem &)
+            { return true; },
+            [&aggregate](const MenuItem &item)
+            { aggregate.add(item.getAggregate()); });
+        checksum += aggregate.vegetarianCount + aggregate.averagePrice();
+    };
+    auto run = [&](size_t operations, size_t updatePercent, auto query)
+    {
+        return measure([&]
+                       {
+                           for (size_t op = 0; op < operations; ++op)
+                           {
+                               if (pick(100) < updatePercent)
+                                   update();
+                               else
+                                   query();
+                           } });
+    };
+
+    std::cout << "aggregates: " << root->getAggregate().itemCount << " items in " << menus.size()
+              << " menus, queries over the top " << QUERIED_MENUS << " menus\n";
+    for (size_t updatePercent : {1, 10, 50})
+    {
+        BenchmarkRun cached = run(OPERATIONS, updatePercent, cachedQuery);
+        BenchmarkRun walked = run(WALKED_OPERATIONS, updatePercent, walkedQuery);
+        std::cout << "  " << updatePercent << "% updates: cached aggregates " << OPERATIONS / cached.seconds / 1e6
+                  << "M ops/s, walking the subtree " << WALKED_OPERATIONS / walked.seconds / 1e3 << "k ops/s\n";
+    }
+    BenchmarkRun updates = run(OPERATIONS, 100, cachedQuery);
+    std::cout << "  update alone: " << updates.seconds * 1e9 / OPERATIONS << " ns (checksum " << checksum << ")\n";
+}
+
+void benchmarkParallel(size_t nodes)
+{
+    const size_t REPEATS = 5;
+    std::unique_ptr<Menu> root = buildBenchmarkMenu(nodes, 64, 4);
+    auto cheapVegetarian = [](const MenuItem &item)
+    { return item.isVegetarian() && item.getPrice() < 20.0; };
+
+    std::cout << "parallel: " << root->getAggregate().itemCount << " items, fan-out 64, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    double baseline[3] = {};
+    for (size_t threads : {1, 2, 4, 8, 16})
+    {
+        Waitress waitress(root.get(), threads);
+        // The first reduction starts the pool; keep that out of the timings.
+        waitress.countItems(cheapVegetarian);
+        size_t counted = 0;
+        size_t filtered = 0;
+        double sum = 0;
+        double seconds[3] = {
+            measure([&]
+                    {
+                        for (size_t r = 0; r < REPEATS; ++r)
+                            counted = waitress.countItems(cheapVegetarian); })
+                .seconds,
+            measure([&]
+                    {
+                        for (size_t r = 0; r < REPEATS; ++r)
+                            filtered = waitress.filterItems(cheapVegetarian).size(); })
+                .seconds,
+            measure([&]
+                    {
+                        for (size_t r = 0; r < REPEATS; ++r)
+                            sum = waitress.sumPrices(cheapVegetarian); })
+                .seconds,
+        };
+        if (threads == 1)
+        {
+            std::copy(seconds, seconds + 3, baseline);
+        }
+        std::cout << "  " << threads << " threads: count " << seconds[0] * 1e3 / REPEATS << " ms ("
+                  << baseline[0] / seconds[0] << "x), filter " << seconds[1] * 1e3 / REPEATS << " ms ("
+                  << baseline[1] / seconds[1] << "x), sum " << seconds[2] * 1e3 / REPEATS << " ms ("
+                  << baseline[2] / seconds[2] << "x); " << counted << " matches, " << filtered << " kept, sum " << sum << "\n";
+    }
+}
+
+// Large arena blocks come straight from mmap, which uordblks leaves out.
+size_t liveHeapBytes()
+{
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+void benchmarkArena(size_t nodes)
+{
+    size_t heapBytes = liveHeapBytes();
+    std::unique_ptr<Menu> heap;
+    BenchmarkRun heapBuild = measure([&]
+                                     { heap = buildBenchmarkMenu(nodes, 16, 2); });
+    heapBytes = liveHeapBytes() - heapBytes;
+    size_t items = heap->getAggregate().itemCount;
+    BenchmarkRun heapTeardown = measure([&]
+                                        { heap.reset(); });
+
+    size_t arenaBytes = liveHeapBytes();
+    std::unique_ptr<MenuArena> arena;
+    BenchmarkRun arenaBuild = measure([&]
+                                      {
+                                          arena = std::make_unique<MenuArena>("All Menus", "All menus combined");
+                                          fillBenchmarkMenu(
+                                              arena->root(), nodes, 16, 2, [&arena](const std::string &name, const char *description)
+                                              { return arena->createMenu(name, description); },
+                                              [&arena](const std::string &name, const char *description, bool vegetarian, double price)
+                                              { return arena->createItem(name, description, vegetarian, price); }); });
+    arenaBytes = liveHeapBytes() - arenaBytes;
+    BenchmarkRun arenaTeardown = measure([&]
+                                         { arena.reset(); });
+
+    auto report = [nodes](const char *tree, const BenchmarkRun &build, const BenchmarkRun &teardown, size_t bytes)
+    {
+        std::cout << "  " << tree << ": build " << build.seconds << " s, " << build.allocations << " allocations, "
+                  << static_cast<double>(bytes) / nodes << " bytes per node; teardown " << teardown.seconds << " s\n";
+    };
+    std::cout << "arena: " << nodes << " nodes, " << items << " items, fan-out 16\n";
+    report("heap nodes", heapBuild, heapTeardown, heapBytes);
+    report("arena nodes", arenaBuild, arenaTeardown, arenaBytes);
+}
+
+void benchmarkPaths(size_t nodes)
+{
+    const size_t QUERIES = 100000;
+    const size_t WALKED_NAME_QUERIES = 20;
+    std::unique_ptr<Menu> root = buildBenchmarkMenu(nodes, 16, 2);
+    std::vector<MenuComponent *> components{root.get()};
+    for (size_t i = 0; i < components.size(); ++i)
+    {
+        if (components[i]->getKind() == NodeKind::Menu)
+        {
+            Menu *menu = static_cast<Menu *>(components[i]);
+            for (int child = 0; child < menu->getNumberOfChildren(); ++child)
+                components.push_back(menu->getChild(child));
+        }
+    }
+
+    size_t bytes = liveHeapBytes();
+    std::unique_ptr<MenuPathIndex> index;
+    BenchmarkRun build = measure([&]
+                                 { index = std::make_unique<MenuPathIndex>(root.get()); });
+    bytes = liveHeapBytes() - bytes;
+
+    std::mt19937 random(11);
+    std::vector<std::string> paths;
+    for (size_t q = 0; q < QUERIES; ++q)
+    {
+        paths.push_back(index->pathOf(components[random() % components.size()]));
+    }
+    // Resolves a path the way callers did before the index: one name
+    // comparison per child, level by level.
+    auto walk = [&root](std::string_view path) -> MenuComponent *
+    {
+        size_t slash = path.find('/');
+        if (path.substr(0, slash) != root->getName())
+            return nullptr;
+        MenuComponent *node = root.get();
+        while (slash != std::string_view::npos)
+        {
+            path.remove_prefix(slash + 1);
+            slash = path.find('/');
+            std::string_view name = path.substr(0, slash);
+            if (node->getKind() != NodeKind::Menu)
+                return nullptr;
+            Menu *menu = static_cast<Menu *>(node);
+            node = nullptr;
+            for (int i = 0; i < menu->getNumberOfChildren() && !node; ++i)
+            {
+                if (menu->getChild(i)->getName() == name)
+                    node = menu->getChild(i);
+            }
+            if (!node)
+                return nullptr;
+        }
+        return node;
+    };
+
+    size_t found = 0;
+    BenchmarkRun indexed = measure([&]
+                                   {
+                                       for (const std::string &path : paths)
+                                           found += index->find(path) != nullptr; });
+    size_t walkedFound = 0;
+    BenchmarkRun walked = measure([&]
+                                  {
+                                      for (const std::string &path : paths)
+                                          walkedFound += walk(path) != nullptr; });
+
+    size_t named = 0;
+    BenchmarkRun byName = measure([&]
+                                  {
+                                      for (size_t q = 0; q < QUERIES; ++q)
+                                          named += index->findByName(components[(q + 1) * 7919 % components.size()]->getName()).size(); });
+    size_t walkedNamed = 0;
+    BenchmarkRun byNameWalked = measure([&]
+                                        {
+                                            for (size_t q = 0; q < WALKED_NAME_QUERIES; ++q)
+                                            {
+                                                std::string_view name = components[(q + 1) * 7919 % components.size()]->getName();
+                                                std::unique_ptr<Iterator> iterator(root->createIterator());
+                                                while (iterator->hasNext())
+                                                    walkedNamed += static_cast<MenuComponent *>(iterator->next())->getName() == name;
+                                            } });
+
+    size_t enumerated = 0;
+    std::string firstMenu = index->pathOf(root->getChild(0));
+    BenchmarkRun prefix = measure([&]
+                                  { index->forEachUnder(firstMenu, [&enumerated](std::string_view, MenuComponent *)
+                                                        { ++enumerated; }); });
+
+    std::cout << "paths: " << index->size() << " indexed paths\n"
+              << "  index build: " << build.seconds << " s, " << static_cast<double>(bytes) / index->size()
+              << " bytes per node\n"
+              << "  path lookup: indexed " << indexed.seconds * 1e9 / QUERIES << " ns, walking "
+              << walked.seconds * 1e9 / QUERIES << " ns (" << found << " and " << walkedFound << " of " << QUERIES << " found)\n"
+              << "  name lookup: indexed " << byName.seconds * 1e9 / QUERIES << " ns, scanning "
+              << byNameWalked.seconds * 1e3 / WALKED_NAME_QUERIES << " ms (" << named << " and " << walkedNamed << " hits)\n"
+              << "  subtree enumeration: " << enumerated << " paths under " << firstMenu << " at "
+              << enumerated / prefix.seconds / 1e6 << "M paths/s\n";
+}
+
+void benchmarkRemoval(size_t children)
+{
+    // Preserve-order removal one child at a time shifts the tail each time,
+    // so only this share of its removals is timed.
+    const size_t SHIFTED_SHARE = 10;
+    std::mt19937 random(13);
+    std::vector<size_t> order(children);
+    for (size_t i = 0; i < children; ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), random);
+
+    std::unique_ptr<Menu> menu;
+    std::vector<MenuItem *> items;
+    auto fill = [&]
+    {
+        menu = std::make_unique<Menu>("Wide Menu", "One very wide menu");
+        items.clear();
+        for (size_t i = 0; i < children; ++i)
+        {
+            items.push_back(new MenuItem("dish " + std::to_string(i), "house special", i % 3 == 0, 1.0 + i % 500 / 10.0));
+            menu->addComponent(items.back());
+        }
+    };
+    auto report = [](const char *removal, const BenchmarkRun &run, size_t removed, size_t left)
+    {
+        std::cout << "  " << removal << ": " << run.seconds * 1e9 / removed << " ns per child, "
+                  << run.seconds * 1e3 << " ms for " << removed << ", " << left << " left\n";
+    };
+    std::cout << "removal: " << children << " children of one menu, removed in random order\n";
+
+    fill();
+    size_t shifted = children / SHIFTED_SHARE;
+    BenchmarkRun preserving = measure([&]
+                                      {
+                                          for (size_t i = 0; i < shifted; ++i)
+                                              menu->removeComponent(items[order[i]], ChildOrder::Preserve); });
+    report("one at a time, order preserved", preserving, shifted, menu->getNumberOfChildren());
+
+    fill();
+    BenchmarkRun unordered = measure([&]
+                                     {
+                                         for (size_t i : order)
+                                             menu->removeComponent(items[i], ChildOrder::Unordered); });
+    report("one at a time, swap and pop", unordered, children, menu->getNumberOfChildren());
+
+    fill();
+    std::vector<MenuHandle> handles;
+    for (size_t i : order)
+        handles.push_back(items[i]->getHandle());
+    BenchmarkRun byHandle = measure([&]
+                                    {
+                                        for (MenuHandle handle : handles)
+                                            menu->removeComponent(handle, ChildOrder::Unordered); });
+    report("by handle, swap and pop", byHandle, children, menu->getNumberOfChildren());
+    size_t stale = 0;
+    for (MenuHandle handle : handles)
+        stale += !menu->removeComponent(handle);
+    std::cout << "  stale handles rejected: " << stale << " of " << handles.size() << "\n";
+
+    fill();
+    std::vector<MenuComponent *> batch;
+    for (size_t i : order)
+        batch.push_back(items[i]);
+    BenchmarkRun batched = measure([&]
+                                   { menu->removeComponents(batch, ChildOrder::Preserve); });
+    report("one batch, order preserved", batched, children, menu->getNumberOfChildren());
+}
+
+void benchmarkRender(size_t items)
+{
+    const size_t ROUNDS = 50;
+    const size_t MUTATIONS_PER_MILLE = 10;
+    std::unique_ptr<Menu> root = buildBenchmarkMenu(items * 8 / 7, 16, 2);
+    std::vector<MenuItem *> priced;
+    forEachItem(
+        root.get(), [](const MenuItem &)
+        { return true; },
+        [&priced](MenuItem &item)
+        { priced.push_back(&item); });
+
+    // What print() did before the caches: format every line on every call.
+    auto formatAll = [&root](std::ostream &out)
+    {
+        out << "\n"
+            << root->getName() << ", " << root->getDescription() << "\n---------------------\n";
+        std::unique_ptr<Iterator> iterator(root->createIterator());
+        while (iterator->hasNext())
+        {
+            MenuComponent *component = static_cast<MenuComponent *>(iterator->next());
+            if (component->getKind() == NodeKind::Menu)
+                out << "\n"
+                    << component->getName() << ", " << component->getDescription() << "\n---------------------\n";
+            else
+                static_cast<MenuItem *>(component)->render(out);
+        }
+    };
+
+    std::mt19937 random(17);
+    size_t mutations = priced.size() * MUTATIONS_PER_MILLE / 1000;
+    double cachedSeconds = 0;
+    double fullSeconds = 0;
+    size_t formatted = 0;
+    size_t rendered = 0;
+    bool identical = true;
+    for (size_t round = 0; round <= ROUNDS; ++round)
+    {
+        for (size_t m = 0; m < mutations; ++m)
+        {
+            priced[random() % priced.size()]->setPrice(1.0 + random() % 500 / 10.0);
+        }
+        std::ostringstream cachedOut;
+        std::ostringstream fullOut;
+        MenuRendering rendering;
+        BenchmarkRun cached = measure([&]
+                                      {
+                                          root->render(rendering);
+                                          rendering.writeTo(cachedOut); });
+        BenchmarkRun full = measure([&]
+                                    { formatAll(fullOut); });
+        identical = identical && cachedOut.str() == fullOut.str();
+        // The first round fills the caches; the rest are steady state.
+        if (round > 0)
+        {
+            cachedSeconds += cached.seconds;
+            fullSeconds += full.seconds;
+            formatted += rendering.formattedBytes();
+            rendered += rendering.size();
+        }
+    }
+
+    std::cout << "render: " << priced.size() << " items, " << mutations << " price edits before each of "
+              << ROUNDS << " renders\n"
+              << "  cached segments: " << cachedSeconds * 1e3 / ROUNDS << " ms per render, "
+              << formatted / ROUNDS << " of " << rendered / ROUNDS << " bytes formatted\n"
+              << "  formatting every line: " << fullSeconds * 1e3 / ROUNDS << " ms per render, "
+              << rendered / ROUNDS << " bytes formatted\n"
+              << "  output identical: " << (identical ? "yes" : "no") << "\n";
+}
+
+void benchmarkPersistent(size_t nodes)
+{
+    const size_t READERS = 2;
+    const size_t RETAINED_EDITS = 10000;
+    const auto PHASE = std::chrono::seconds(1);
+    std::unique_ptr<Menu> source = buildBenchmarkMenu(nodes, 16, 2);
+    PersistentMenu menu(source.get());
+
+    std::vector<std::string> itemPaths;
+    std::vector<std::pair<Menu *, std::string>> pending{{source.get(), std::string(source->getName())}};
+    while (!pending.empty())
+    {
+        auto [parent, path] = pending.back();
+        pending.pop_back();
+        for (int i = 0; i < parent->getNumberOfChildren(); ++i)
+        {
+            MenuComponent *child = parent->getChild(i);
+            std::string childPath = path + "/" + std::string(child->getName());
+            if (child->getKind() == NodeKind::Menu)
+                pending.emplace_back(static_cast<Menu *>(child), std::move(childPath));
+            else
+                itemPaths.push_back(std::move(childPath));
+        }
+    }
+    source.reset();
+
+    std::mt19937 random(19);
+    auto edit = [&]
+    {
+        const std::string &path = itemPaths[random() % itemPaths.size()];
+        std::string_view name = std::string_view(path).substr(path.rfind('/') + 1);
+        return menu.replaceComponent(path, menu.makeItem(name, "house special", false, 1.0 + random() % 500 / 10.0));
+    };
+
+    // Readers sum every price of one snapshot per pass while an optional
+    // editor keeps publishing new roots.
+    auto runPhase = [&](bool editing, size_t &edits)
+    {
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> itemsRead{0};
+        std::vector<std::thread> readers;
+        for (size_t r = 0; r < READERS; ++r)
+        {
+            readers.emplace_back([&]
+                                 {
+                                     double sum = 0;
+                                     while (!stop)
+                                     {
+                                         PersistentMenu::Snapshot snapshot(menu);
+                                         size_t read = 0;
+                                         PersistentMenu::forEachItem(snapshot.root(), [&](const PersistentMenuNode &item)
+                                                                     {
+                                                                         sum += item.price;
+                                                                         ++read; });
+                                         itemsRead += read;
+                                     }
+                                     if (sum < 0)
+                                         std::cout << sum; });
+        }
+        auto begin = std::chrono::steady_clock::now();
+        edits = 0;
+        while (std::chrono::steady_clock::now() - begin < PHASE)
+        {
+            if (editing)
+                edits += edit();
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        stop = true;
+        for (std::thread &reader : readers)
+            reader.join();
+        return itemsRead / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+
+    size_t edits = 0;
+    double quietRate = runPhase(false, edits);
+    double editedRate = runPhase(true, edits);
+
+    std::vector<PersistentMenu::Snapshot> retained;
+    retained.reserve(RETAINED_EDITS);
+    size_t bytes = liveHeapBytes();
+    BenchmarkRun edited = measure([&]
+                                  {
+                                      for (size_t e = 0; e < RETAINED_EDITS; ++e)
+                                      {
+                                          edit();
+                                          retained.emplace_back(menu);
+                                      } });
+    bytes = liveHeapBytes() - bytes;
+
+    std::cout << "persistent: " << itemPaths.size() << " items, " << READERS << " readers\n"
+              << "  reads without edits: " << quietRate / 1e6 << "M items/s\n"
+              << "  reads during edits: " << editedRate / 1e6 << "M items/s while publishing "
+              << edits / std::chrono::duration<double>(PHASE).count() << " edits/s\n"
+              << "  edit: " << edited.seconds * 1e6 / RETAINED_EDITS << " us, "
+              << static_cast<double>(edited.allocations) / RETAINED_EDITS << " allocations, "
+              << static_cast<double>(bytes) / RETAINED_EDITS << " bytes per version kept alive\n";
+}
+
+void benchmarkSnapshot(size_t nodes)
+{
+    const size_t RESIDENT_LIMIT = 64;
+    const size_t DESCENTS = 1000;
+    std::string path = (std::filesystem::temp_directory_path() / "benchmark_menus.XXXXXX").string();
+    int file = mkstemp(path.data());
+    if (file < 0)
+    {
+        std::cerr << "Cannot create a temporary menu snapshot\n";
+        return;
+    }
+    close(file);
+    {
+        std::unique_ptr<Menu> source = buildBenchmarkMenu(nodes, 16, 2);
+        MenuSnapshot::write(source.get(), path);
+    }
+    // The first open after writing pays for the freshly written pages; the
+    // timings below are for a file already in the page cache.
+    MenuSnapshot(path, 1).root()->getChild(0);
+    std::mt19937 random(23);
+    // Follows random submenus that hold items down to the bottom of the
+    // tree, then reads one of the items there.
+    auto descend = [&random](Menu *root)
+    {
+        Menu *menu = root;
+        std::vector<int> submenus;
+        std::vector<int> items;
+        while (true)
+        {
+            submenus.clear();
+            items.clear();
+            for (int i = 0; i < menu->getNumberOfChildren(); ++i)
+            {
+                MenuComponent *child = menu->getChild(i);
+                if (child->getKind() == NodeKind::Item)
+                    items.push_back(i);
+                else if (child->getAggregate().itemCount > 0)
+                    submenus.push_back(i);
+            }
+            if (submenus.empty())
+                break;
+            menu = static_cast<Menu *>(menu->getChild(submenus[random() % submenus.size()]));
+        }
+        return items.empty() ? 0.0 : menu->getChild(items[random() % items.size()])->getPrice();
+    };
+    auto report = [](const char *load, size_t heapBytes, size_t blockBytes)
+    {
+        std::cout << "  " << load << " resident: " << heapBytes / 1e6 << " MB of nodes, " << blockBytes / 1e6
+                  << " MB of mapped blocks\n";
+    };
+
+    size_t heapBytes = liveHeapBytes();
+    std::unique_ptr<MenuSnapshot> lazy;
+    BenchmarkRun opened = measure([&]
+                                  { lazy = std::make_unique<MenuSnapshot>(path, RESIDENT_LIMIT); });
+    double price = 0;
+    BenchmarkRun first = measure([&]
+                                 { price += descend(lazy->root()); });
+    BenchmarkRun later = measure([&]
+                                 {
+                                     for (size_t d = 0; d < DESCENTS; ++d)
+                                         price += descend(lazy->root()); });
+    std::cout << "snapshot: " << lazy->menuCount() << " menu blocks, " << std::filesystem::file_size(path) / 1e6
+              << " MB file, resident limit " << RESIDENT_LIMIT << " blocks\n"
+              << "  lazy open: " << opened.seconds * 1e6 << " us, first item reached in " << first.seconds * 1e6
+              << " us, then " << later.seconds * 1e6 / DESCENTS << " us per random descent\n";
+    report("lazy", liveHeapBytes() - heapBytes, lazy->residentBlockBytes());
+    lazy.reset();
+
+    heapBytes = liveHeapBytes();
+    std::unique_ptr<MenuSnapshot> full;
+    size_t items = 0;
+    BenchmarkRun loaded = measure([&]
+                                  {
+                                      full = std::make_unique<MenuSnapshot>(path, std::numeric_limits<size_t>::max());
+                                      forEachItem(
+                                          full->root(), [](const MenuItem &)
+                                          { return true; },
+                                          [&items](MenuItem &)
+                                          { ++items; });
+                                  });
+    std::cout << "  full load: " << loaded.seconds * 1e3 << " ms for " << items << " items (price check " << price
+              << ")\n";
+    report("full", liveHeapBytes() - heapBytes, full->residentBlockBytes());
+    full.reset();
+    std::remove(path.c_str());
+}
+
+int runBenchmarks(int argc, char **argv)
+{
+    struct Benchmark
+    {
+        const char *name;
+        void (*run)(size_t);
+        size_t defaultScale;
+    };
+    const Benchmark benchmarks[] = {
+        {"frozen", benchmarkFrozen, 10000000},
+        {"vegetarian", benchmarkVegetarian, 1000000},
+        {"aggregates", benchmarkAggregates, 1000000},
+        {"parallel", benchmarkParallel, 5000000},
+        {"arena", benchmarkArena, 5000000},
+        {"paths", benchmarkPaths, 1000000},
+        {"removal", benchmarkRemoval, 100000},
+        {"render", benchmarkRender, 100000},
+        {"persistent", benchmarkPersistent, 1000000},
+        {"snapshot", benchmarkSnapshot, 2000000},
+    };
+    std::string_view only = argc > 0 ? argv[0] : "";
+    size_t scale = argc > 1 ? std::stoull(argv[1]) : 0;
+    bool ran = false;
+    for (const Benchmark &benchmark : benchmarks)
+    {
+        if (only.empty() || only == benchmark.name)
+        {
+            benchmark.run(scale ? scale : benchmark.defaultScale);
+            ran = true;
+        }
+    }
+    if (!ran)
+    {
+        std::cerr << "Unknown benchmark: " << only << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Run with --benchmark [name] [scale] to time the menus instead of printing
+// the demo.
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark")
+    {
+        return runBenchmarks(argc - 2, argv + 2);
+    }
+
+    MenuComponent *pancakeHouseMenu = new Menu("Pancake House", "Breakfast");
+    MenuComponent *dinerMenu = new Menu("Diner", "Lunch");
+    MenuComponent *cafeMenu = new Menu("Cafe", "Evenings");
+    MenuComponent *dessertMenu = new Menu("Dessert Menu", "Dessert of course!");
+
+    MenuComponent *allMenus = new Menu("All Menus", "All available menus");
+    allMenus->addComponent(pancakeHouseMenu);
+    allMenus->addComponent(dinerMenu);
+    allMenus->addComponent(cafeMenu);
+
+    pancakeHouseMenu->addComponent(new MenuItem("Fruit Bowl", "A bowl of fresh fruit", true, 3.99));
+    dinerMenu->addComponent(new MenuItem("Pasta", "Spaghetti with Marinara Sauce, and a slice of sourdough bread", true, 3.89));
+    cafeMenu->addComponent(new MenuItem("Veggie Burger and Air Fries", "Veggie burger on a whole wheat bun, lettuce, tomato, and fries", true, 6.95));
+
+    dinerMenu->addComponent(dessertMenu);
+    dessertMenu->addComponent(new MenuItem("Apple Pie", "Apple pie with a flaky crust, topped with vanilla ice cream", true, 1.59));
+
+    Waitress waitress(allMenus);
+    waitress.printMenu();
+
+    std::cout << std::endl;
+
+    waitress.printVegetarianMenu();
+    std::cout << std::endl;
+
+    waitress.printVegetarianMenu();
+    std::cout << std::endl;
+
+    waitress.printVegetarianMenu();
+    std::cout << std::endl;
+
+    MenuAggregate dinerTotals = dinerMenu->getAggregate();
+    std::cout << "Diner has " << dinerTotals.itemCount << " items (" << dinerTotals.vegetarianCount
+              << " vegetarian), prices " << dinerTotals.priceMin << " to " << dinerTotals.priceMax
+              << ", average " << dinerTotals.averagePrice() << std::endl;
+    std::cout << "Aggregates after 2000 seeded edits "
+              << (aggregatesMatchBruteForce(2024, 2000) ? "match" : "DO NOT match") << " a brute-force walk" << std::endl;
+
+    std::cout << waitress.countItems([](const MenuItem &item)
+                                     { return item.isVegetarian(); })
+              << " vegetarian items worth "
+              << waitress.sumPrices([](const MenuItem &item)
+                                    { return item.isVegetarian(); })
+              << std::endl;
+
+    std::cout << "Apple Pie is "
+              << (waitress.isItemVegetarian("Apple Pie") ? "vegetarian." : "not vegetarian.") << std::endl
+              << std::endl;
+
+    {
+        MenuPathIndex pathIndex(static_cast<Menu *>(allMenus));
+        dessertMenu->addComponent(new MenuItem("Cheesecake", "Creamy New York cheesecake", true, 1.99));
+        std::cout << "Desserts:" << std::endl;
+        pathIndex.forEachUnder("All Menus/Diner/Dessert Menu", [](std::string_view path, MenuComponent *component)
+                               {
+                                   if (component->getKind() == NodeKind::Item)
+                                       std::cout << "  " << path << std::endl; });
+        std::cout << std::endl;
+    }
+
+    MenuArena specials("Specials", "Today only");
+    Menu *soups = specials.createMenu("Soups", "Served hot");
+    specials.root()->addComponent(soups);
+    soups->addComponent(specials.createItem("Tomato Soup", "Roasted tomato with basil", true, 2.49));
+    MenuItem *clubSandwich = specials.createItem("Club Sandwich", "Triple-decker with turkey and bacon", false, 5.49);
+    specials.root()->addComponent(clubSandwich);
+    specials.root()->addComponent(specials.createItem("Lemonade", "Freshly squeezed", true, 1.29));
+    MenuHandle clubHandle = clubSandwich->getHandle();
+    specials.root()->removeComponent(clubHandle, ChildOrder::Unordered);
+    std::cout << "Club Sandwich handle is "
+              << (MenuHandleTable::getInstance().resolve(clubHandle) ? "live" : "stale") << std::endl;
+    std::cout << "Removals after 2000 seeded operations "
+              << (handleRemovalsMatchModel(2024, 2000) ? "match" : "DO NOT match") << " a reference list" << std::endl;
+    specials.root()->print();
+    std::cout << std::endl;
+
+    PersistentMenu liveMenus(allMenus);
+    std::atomic<bool> editing{true};
+    std::thread reader([&liveMenus, &editing]
+                       {
+                           while (editing)
+                           {
+                               PersistentMenu::Snapshot snapshot(liveMenus);
+                               size_t items = 0;
+                               PersistentMenu::forEachItem(snapshot.root(), [&items](const PersistentMenuNode &)
+                                                           { ++items; });
+                           } });
+    liveMenus.addComponent("All Menus/Cafe", liveMenus.makeItem("Latte", "Espresso with steamed milk", true, 3.25));
+    liveMenus.replaceComponent("All Menus/Diner/Pasta", liveMenus.makeItem("Pasta", "Spaghetti with Marinara Sauce", true, 4.29));
+    liveMenus.removeComponent("All Menus/Pancake House/Fruit Bowl");
+    editing = false;
+    reader.join();
+    {
+        PersistentMenu::Snapshot snapshot(liveMenus);
+        std::cout << "Published menu items:" << std::endl;
+        PersistentMenu::forEachItem(snapshot.root(), [](const PersistentMenuNode &item)
+                                    { std::cout << "  " << item.name << ", " << item.price << std::endl; });
+        std::cout << std::endl;
+    }
+
+    std::string snapshotPath = (std::filesystem::temp_directory_path() / "all_menus.XXXXXX").string();
+    int snapshotFile = mkstemp(snapshotPath.data());
+    if (snapshotFile < 0)
+    {
+        std::cerr << "Cannot create a temporary menu snapshot" << std::endl;
+        return 1;
+    }
+    close(snapshotFile);
+    MenuSnapshot::write(static_cast<Menu *>(allMenus), snapshotPath);
+    {
+        MenuSnapshot snapshot(snapshotPath, 2);
+        snapshot.root()->getChild(1)->getChild(1)->print();
+        std::cout << "Snapshot menus resident: " << snapshot.residentMenus() << " of " << snapshot.menuCount() << std::endl;
+        MenuComponent *cafe = snapshot.root()->getChild(2);
+        std::cout << cafe->getName() << " starts with " << cafe->getChild(0)->getName() << ", snapshot menus resident: "
+                  << snapshot.residentMenus() << " of " << snapshot.menuCount() << std::endl
+                  << std::endl;
+    }
+    std::remove(snapshotPath.c_str());
+
+    FrozenMenu frozenMenus(allMenus);
+    std::cout << "Frozen menu with " << frozenMenus.size() << " nodes:" << std::endl;
+    frozenMenus.printVegetarian();
     std::cout << std::endl;
 
     delete allMenus;
@@ -2,32 +2,142 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <unordered_map>
+#include <limits>
+#include <new>
+#include <cstddef>
+#include <queue>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <streambuf>
+#include <malloc.h>
+
+// Names are only ever appended and live in fixed chunks that never move, so
+// Get reads without locking; only Intern takes the mutex.
+class NamePool
+{
+public:
+    NamePool() = default;
+    NamePool(const NamePool &) = delete;
+    NamePool &operator=(const NamePool &) = delete;
+
+    ~NamePool()
+    {
+        for (std::atomic<std::string *> &chunk : _chunks)
+        {
+            delete[] chunk.load();
+        }
+    }
+
+    uint32_t Intern(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _ids.find(name);
+        if (it != _ids.end())
+            return it->second;
+        uint32_t index = _size.load(std::memory_order_relaxed);
+        if (index == CHUNK_SIZE * CHUNK_COUNT)
+        {
+            throw std::runtime_error("Too many distinct names");
+        }
+        std::string *chunk = _chunks[index / CHUNK_SIZE].load(std::memory_order_relaxed);
+        if (!chunk)
+        {
+            chunk = new std::string[CHUNK_SIZE];
+            _chunks[index / CHUNK_SIZE].store(chunk, std::memory_order_release);
+        }
+        std::string &slot = chunk[index % CHUNK_SIZE];
+        slot = name;
+        _size.store(index + 1, std::memory_order_release);
+        _ids.emplace(slot, index + 1);
+        return index + 1;
+    }
+
+    std::string_view Get(uint32_t id) const
+    {
+        if (id == 0 || id > _size.load(std::memory_order_acquire))
+            return std::string_view();
+        uint32_t index = id - 1;
+        return _chunks[index / CHUNK_SIZE].load(std::memory_order_acquire)[index % CHUNK_SIZE];
+    }
+
+private:
+    static constexpr uint32_t CHUNK_SIZE = 256;
+    static constexpr uint32_t CHUNK_COUNT = 1024;
+
+    std::mutex _mutex;
+    std::atomic<std::string *> _chunks[CHUNK_COUNT] = {};
+    std::atomic<uint32_t> _size{0};
+    std::unordered_map<std::string_view, uint32_t> _ids;
+};
+
+inline NamePool &PizzaNames()
+{
+    static NamePool pool;
+    return pool;
+}
+
+typedef uint16_t IngredientId;
+
+inline NamePool &IngredientNames()
+{
+    static NamePool pool;
+    return pool;
+}
+
+inline IngredientId InternIngredient(const std::string &name)
+{
+    uint32_t id = IngredientNames().Intern(name);
+    if (id > std::numeric_limits<IngredientId>::max())
+    {
+        throw std::runtime_error("Too many distinct ingredients");
+    }
+    return static_cast<IngredientId>(id);
+}
 
 class Dough
 {
 public:
-    Dough(const std::string &type) : _type(type) {}
-    std::string GetType() const { return _type; }
+    Dough(const std::string &type) : _type(type), _id(InternIngredient(type)) {}
+    const std::string &GetType() const { return _type; }
+    IngredientId GetId() const { return _id; }
 
 protected:
     std::string _type;
+    IngredientId _id;
 };
 
 class Sauce
 {
 public:
-    Sauce(const std::string &type) : _type(type) {}
-    std::string GetType() const { return _type; }
+    Sauce(const std::string &type) : _type(type), _id(InternIngredient(type)) {}
+    const std::string &GetType() const { return _type; }
+    IngredientId GetId() const { return _id; }
 
 protected:
     std::string _type;
+    IngredientId _id;
 };
 
 class Topping
 {
 public:
     Topping(const std::string &name) : _name(name) {}
-    std::string GetName() const { return _name; }
+    const std::string &GetName() const { return _name; }
 
 protected:
     std::string _name;
@@ -36,43 +146,94 @@ protected:
 class Cheese
 {
 public:
-    Cheese(const std::string &type) : _type(type) {}
-    std::string GetType() const { return _type; }
+    Cheese(const std::string &type) : _type(type), _id(InternIngredient(type)) {}
+    const std::string &GetType() const { return _type; }
+    IngredientId GetId() const { return _id; }
 
 protected:
     std::string _type;
+    IngredientId _id;
 };
 
 class Pepperoni
 {
 public:
-    Pepperoni(const std::string &type) : _type(type) {}
-    std::string GetType() const { return _type; }
+    Pepperoni(const std::string &type) : _type(type), _id(InternIngredient(type)) {}
+    const std::string &GetType() const { return _type; }
+    IngredientId GetId() const { return _id; }
 
 protected:
     std::string _type;
+    IngredientId _id;
 };
 
 class Clams
 {
 public:
-    Clams(const std::string &type) : _type(type) {}
-    std::string GetType() const { return _type; }
+    Clams(const std::string &type) : _type(type), _id(InternIngredient(type)) {}
+    const std::string &GetType() const { return _type; }
+    IngredientId GetId() const { return _id; }
 
 protected:
     std::string _type;
+    IngredientId _id;
 };
 
 class Veggies
 {
 public:
-    Veggies(const std::string &name) : _name(name) {}
-    std::string GetName() const { return _name; }
+    Veggies(const std::string &name) : _name(name), _id(InternIngredient(name)) {}
+    const std::string &GetName() const { return _name; }
+    IngredientId GetId() const { return _id; }
 
 protected:
     std::string _name;
+    IngredientId _id;
+};
+
+struct alignas(32) PizzaValue
+{
+    static const size_t MAX_VEGGIES = 8;
+
+    uint32_t name = 0;
+    IngredientId dough = 0;
+    IngredientId sauce = 0;
+    IngredientId cheese = 0;
+    IngredientId pepperoni = 0;
+    IngredientId clam = 0;
+    uint8_t veggieCount = 0;
+    IngredientId veggies[MAX_VEGGIES] = {};
+
+    std::string ToString() const
+    {
+        const NamePool &ingredients = IngredientNames();
+        std::string result = "---- ";
+        result.append(PizzaNames().Get(name)).append(" ----\n");
+        if (dough)
+            result.append("Dough: ").append(ingredients.Get(dough)).append("\n");
+        if (sauce)
+            result.append("Sauce: ").append(ingredients.Get(sauce)).append("\n");
+        if (cheese)
+            result.append("Cheese: ").append(ingredients.Get(cheese)).append("\n");
+        if (veggieCount)
+        {
+            result += "Veggies: ";
+            for (uint8_t i = 0; i < veggieCount; ++i)
+            {
+                result.append(ingredients.Get(veggies[i])).append(" ");
+            }
+            result += "\n";
+        }
+        if (pepperoni)
+            result.append("Pepperoni: ").append(ingredients.Get(pepperoni)).append("\n");
+        if (clam)
+            result.append("Clams: ").append(ingredients.Get(clam)).append("\n");
+        return result;
+    }
 };
 
+static_assert(sizeof(PizzaValue) <= 64, "PizzaValue must fit in one cache line");
+
 class Pizza
 {
 public:
@@ -80,84 +241,75 @@ public:
 
     void Bake()
     {
-        std::cout << "Baking " << _name << std::endl;
+        Announce("Baking");
     }
     void Cut()
     {
-        std::cout << "Cutting diagonally " << _name << std::endl;
+        Announce("Cutting diagonally");
     }
     void Box()
     {
-        std::cout << "Boxing " << _name << std::endl;
+        Announce("Boxing");
     }
-    std::string GetName() const { return _name; }
+    std::string_view GetName() const { return PizzaNames().Get(_value.name); }
 
-    void SetName(const std::string &name) { _name = name; }
+    void SetName(const std::string &name) { _value.name = PizzaNames().Intern(name); }
+    void SetNameId(uint32_t name) { _value.name = name; }
+
+    const PizzaValue &GetValue() const { return _value; }
 
     std::string toString() const
     {
-        std::string result = "---- " + _name + " ----\n";
-        if (_dough)
-            result += "Dough: " + _dough->GetType() + "\n";
-        if (_sauce)
-            result += "Sauce: " + _sauce->GetType() + "\n";
-        if (_cheese)
-            result += "Cheese: " + _cheese->GetType() + "\n";
-        if (!_veggies.empty())
-        {
-            result += "Veggies: ";
-            for (const auto &veggie : _veggies)
-            {
-                result += veggie->GetName() + " ";
-            }
-            result += "\n";
-        }
-        if (_pepperoni)
-            result += "Pepperoni: " + _pepperoni->GetType() + "\n";
-        if (_clam)
-            result += "Clams: " + _clam->GetType() + "\n";
-        return result;
+        return _value.ToString();
+    }
+
+    virtual void Reset()
+    {
+        _value = PizzaValue();
+    }
+
+    virtual ~Pizza() = default;
+
+protected:
+    void Announce(std::string_view step) const
+    {
+        thread_local std::string line;
+        line.assign(step).append(" ").append(GetName()).append("\n");
+        std::cout.write(line.data(), line.size()).flush();
     }
 
-    virtual ~Pizza()
+    void Add(const Dough *dough) { _value.dough = dough->GetId(); }
+    void Add(const Sauce *sauce) { _value.sauce = sauce->GetId(); }
+    void Add(const Cheese *cheese) { _value.cheese = cheese->GetId(); }
+    void Add(const Pepperoni *pepperoni) { _value.pepperoni = pepperoni->GetId(); }
+    void Add(const Clams *clam) { _value.clam = clam->GetId(); }
+
+    void Add(const std::vector<const Veggies *> &veggies)
     {
-        if (_dough)
-            delete _dough;
-        if (_sauce)
-            delete _sauce;
-        if (_cheese)
-            delete _cheese;
-        for (auto &veggie : _veggies)
+        if (veggies.size() > PizzaValue::MAX_VEGGIES)
+        {
+            throw std::runtime_error("Too many veggies for one pizza");
+        }
+        _value.veggieCount = static_cast<uint8_t>(veggies.size());
+        for (size_t i = 0; i < veggies.size(); ++i)
         {
-            if (veggie)
-                delete veggie;
+            _value.veggies[i] = veggies[i]->GetId();
         }
-        if (_pepperoni)
-            delete _pepperoni;
-        if (_clam)
-            delete _clam;
     }
 
-protected:
-    std::string _name;
-    Dough *_dough = nullptr;
-    Sauce *_sauce = nullptr;
-    Cheese *_cheese = nullptr;
-    std::vector<Veggies *> _veggies;
-    Pepperoni *_pepperoni = nullptr;
-    Clams *_clam = nullptr;
+    PizzaValue _value;
 };
 
 class PizzaIngredientFactory
 {
 public:
     virtual ~PizzaIngredientFactory() = default;
-    virtual Dough *CreateDough() = 0;
-    virtual Sauce *CreateSauce() = 0;
-    virtual Cheese *CreateCheese() = 0;
-    virtual std::vector<Veggies *> CreateVeggies() = 0;
-    virtual Pepperoni *CreatePepperoni() = 0;
-    virtual Clams *CreateClam() = 0;
+    virtual const Dough *CreateDough() const = 0;
+    virtual const Sauce *CreateSauce() const = 0;
+    virtual const Cheese *CreateCheese() const = 0;
+    virtual const std::vector<const Veggies *> &CreateVeggies() const = 0;
+    virtual const Pepperoni *CreatePepperoni() const = 0;
+    virtual const Clams *CreateClam() const = 0;
 };
 
 class ThinCrustDough : public Dough
@@ -253,280 +405,1904 @@ public:
 class CheezePizza : public Pizza
 {
 public:
-    CheezePizza(PizzaIngredientFactory *ingredientFactory) : _ingredientFactory(ingredientFactory) {}
+    CheezePizza(const PizzaIngredientFactory &ingredientFactory) : _ingredientFactory(ingredientFactory) {}
     void Prepare() override
     {
-        std::cout << "Preparing " << _name << std::endl;
-        _dough = _ingredientFactory->CreateDough();
-        _sauce = _ingredientFactory->CreateSauce();
-        _cheese = _ingredientFactory->CreateCheese();
-    }
-
-    ~CheezePizza()
-    {
-        delete _ingredientFactory;
+        Announce("Preparing");
+        Add(_ingredientFactory.CreateDough());
+        Add(_ingredientFactory.CreateSauce());
+        Add(_ingredientFactory.CreateCheese());
     }
 
 protected:
-    PizzaIngredientFactory *_ingredientFactory;
+    const PizzaIngredientFactory &_ingredientFactory;
 };
 
 class ClamPizza : public Pizza
 {
 public:
-    ClamPizza(PizzaIngredientFactory *ingredientFactory) : _ingredientFactory(ingredientFactory) {}
+    ClamPizza(const PizzaIngredientFactory &ingredientFactory) : _ingredientFactory(ingredientFactory) {}
     void Prepare() override
     {
-        std::cout << "Preparing " << _name << std::endl;
-        _dough = _ingredientFactory->CreateDough();
-        _sauce = _ingredientFactory->CreateSauce();
-        _cheese = _ingredientFactory->CreateCheese();
-        _clam = _ingredientFactory->CreateClam();
-    }
-
-    ~ClamPizza()
-    {
-        delete _ingredientFactory;
+        Announce("Preparing");
+        Add(_ingredientFactory.CreateDough());
+        Add(_ingredientFactory.CreateSauce());
+        Add(_ingredientFactory.CreateCheese());
+        Add(_ingredientFactory.CreateClam());
     }
 
 protected:
-    PizzaIngredientFactory *_ingredientFactory;
+    const PizzaIngredientFactory &_ingredientFactory;
 };
 
 class VeggiePizza : public Pizza
 {
 public:
-    VeggiePizza(PizzaIngredientFactory *ingredientFactory) : _ingredientFactory(ingredientFactory) {}
+    VeggiePizza(const PizzaIngredientFactory &ingredientFactory) : _ingredientFactory(ingredientFactory) {}
     void Prepare() override
     {
-        std::cout << "Preparing " << _name << std::endl;
-        _dough = _ingredientFactory->CreateDough();
-        _sauce = _ingredientFactory->CreateSauce();
-        _cheese = _ingredientFactory->CreateCheese();
-        _veggies = _ingredientFactory->CreateVeggies();
-    }
-
-    ~VeggiePizza()
-    {
-        delete _ingredientFactory;
+        Announce("Preparing");
+        Add(_ingredientFactory.CreateDough());
+        Add(_ingredientFactory.CreateSauce());
+        Add(_ingredientFactory.CreateCheese());
+        Add(_ingredientFactory.CreateVeggies());
     }
 
 protected:
-    PizzaIngredientFactory *_ingredientFactory;
+    const PizzaIngredientFactory &_ingredientFactory;
 };
 
-class PizzaStore
+typedef Pizza *(*PizzaMaker)(const PizzaIngredientFactory &);
+
+struct PizzaPoolStats
+{
+    size_t allocated;
+    size_t reused;
+    size_t released;
+};
+
+class PizzaPool
 {
 public:
-    PizzaStore() = default;
-    virtual ~PizzaStore() = default;
+    struct Key
+    {
+        PizzaMaker maker;
+        const PizzaIngredientFactory *ingredientFactory;
 
-    Pizza *OrderPizza(const std::string &type)
+        bool operator==(const Key &other) const
+        {
+            return maker == other.maker && ingredientFactory == other.ingredientFactory;
+        }
+    };
+
+    class Recycler
     {
-        Pizza *pizza = CreatePizza(type);
-        if (pizza)
+    public:
+        Recycler(Key key = Key{nullptr, nullptr}) : _key(key) {}
+        void operator()(Pizza *pizza) const { PizzaPool::Release(_key, pizza); }
+
+    private:
+        Key _key;
+    };
+
+    typedef std::unique_ptr<Pizza, Recycler> Handle;
+
+    static Handle Acquire(PizzaMaker maker, const PizzaIngredientFactory &ingredientFactory)
+    {
+        Key key{maker, &ingredientFactory};
+        FreeLists *local = Local();
+        std::vector<Pizza *> *list = local ? &local->lists[key] : nullptr;
+        Pizza *pizza;
+        if (!list || list->empty())
         {
-            pizza->Prepare();
-            pizza->Bake();
-            pizza->Cut();
-            pizza->Box();
+            pizza = maker(ingredientFactory);
+            ++Counters().allocated;
         }
-        return pizza;
+        else
+        {
+            pizza = list->back();
+            list->pop_back();
+            pizza->Reset();
+            ++Counters().reused;
+        }
+        return Handle(pizza, Recycler(key));
     }
 
-protected:
-    virtual Pizza *CreatePizza(const std::string &type) = 0;
-};
+    static void SetHighWaterMark(size_t pizzasPerList)
+    {
+        HighWaterMark() = pizzasPerList;
+    }
 
-class NyPizzaIngredientFactory : public PizzaIngredientFactory
-{
-public:
-    Dough *CreateDough() override
+    static PizzaPoolStats GetStats()
     {
-        return new ThinCrustDough();
+        return PizzaPoolStats{Counters().allocated.load(), Counters().reused.load(), Counters().released.load()};
     }
-    Sauce *CreateSauce() override
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            return std::hash<const void *>()(reinterpret_cast<const void *>(key.maker)) * 31 +
+                   std::hash<const void *>()(key.ingredientFactory);
+        }
+    };
+
+    enum class LocalState : uint8_t
+    {
+        Unborn,
+        Alive,
+        Destroyed
+    };
+
+    struct FreeLists
+    {
+        std::unordered_map<Key, std::vector<Pizza *>, KeyHash> lists;
+
+        FreeLists() { State() = LocalState::Alive; }
+
+        ~FreeLists()
+        {
+            State() = LocalState::Destroyed;
+            for (auto &entry : lists)
+            {
+                for (Pizza *pizza : entry.second)
+                    delete pizza;
+            }
+        }
+    };
+
+    struct AtomicCounters
+    {
+        std::atomic<size_t> allocated{0};
+        std::atomic<size_t> reused{0};
+        std::atomic<size_t> released{0};
+    };
+
+    // The state is trivially destructible, so it can still be read after this
+    // thread's FreeLists is gone; pizzas released from later thread-exit
+    // destructors are then deleted instead of pooled.
+    static LocalState &State()
     {
-        return new MarinaraSauce();
+        thread_local LocalState state = LocalState::Unborn;
+        return state;
     }
-    Cheese *CreateCheese() override
+
+    static FreeLists *Local()
     {
-        return new ReggianoCheese();
+        if (State() == LocalState::Destroyed)
+            return nullptr;
+        thread_local FreeLists freeLists;
+        return &freeLists;
     }
-    std::vector<Veggies *> CreateVeggies() override
+
+    static std::atomic<size_t> &HighWaterMark()
     {
-        return {new Garlic(), new Onion(), new Mushroom(), new RedPepper()};
+        static std::atomic<size_t> mark{64};
+        return mark;
     }
-    Pepperoni *CreatePepperoni() override
+
+    static AtomicCounters &Counters()
     {
-        return new SlicedPepperoni();
+        static AtomicCounters counters;
+        return counters;
     }
-    Clams *CreateClam() override
+
+    static void Release(const Key &key, Pizza *pizza)
     {
-        return new FreshClams();
+        FreeLists *local = Local();
+        if (local)
+        {
+            std::vector<Pizza *> &list = local->lists[key];
+            if (list.size() < HighWaterMark().load(std::memory_order_relaxed))
+            {
+                list.push_back(pizza);
+                return;
+            }
+        }
+        delete pizza;
+        ++Counters().released;
     }
 };
 
-class ChicagoPizzaIngredientFactory : public PizzaIngredientFactory
+typedef PizzaPool::Handle PooledPizza;
+
+typedef uint32_t PizzaTypeId;
+
+constexpr PizzaTypeId PizzaType(std::string_view name)
 {
-public:
-    Dough *CreateDough() override
-    {
-        return new ThickCrustDough();
-    }
-    Sauce *CreateSauce() override
+    uint32_t hash = 2166136261u;
+    for (char c : name)
     {
-        return new PlumTomatoSauce();
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
     }
-    Cheese *CreateCheese() override
+    return hash;
+}
+
+constexpr PizzaTypeId CHEESE_PIZZA = PizzaType("cheese");
+constexpr PizzaTypeId CLAM_PIZZA = PizzaType("clam");
+constexpr PizzaTypeId VEGGIE_PIZZA = PizzaType("veggie");
+constexpr PizzaTypeId PEPPERONI_PIZZA = PizzaType("pepperoni");
+
+constexpr PizzaTypeId KNOWN_PIZZA_TYPES[] = {CHEESE_PIZZA, CLAM_PIZZA, VEGGIE_PIZZA, PEPPERONI_PIZZA};
+
+constexpr bool PizzaTypesAreDistinct()
+{
+    size_t count = sizeof(KNOWN_PIZZA_TYPES) / sizeof(KNOWN_PIZZA_TYPES[0]);
+    for (size_t i = 0; i < count; ++i)
     {
-        return new MozzarellaCheese();
+        for (size_t j = i + 1; j < count; ++j)
+        {
+            if (KNOWN_PIZZA_TYPES[i] == KNOWN_PIZZA_TYPES[j])
+                return false;
+        }
     }
-    std::vector<Veggies *> CreateVeggies() override
+    return true;
+}
+
+static_assert(PizzaTypesAreDistinct(), "Known pizza type names must hash to distinct ids");
+
+typedef Pizza *(*PizzaPlacer)(void *, const PizzaIngredientFactory &);
+
+struct OrderRequest
+{
+    std::string type;
+};
+
+class PizzaBatch
+{
+public:
+    PizzaBatch() = default;
+    PizzaBatch(PizzaBatch &&) = default;
+    PizzaBatch &operator=(PizzaBatch &&) = delete;
+    PizzaBatch(const PizzaBatch &) = delete;
+    PizzaBatch &operator=(const PizzaBatch &) = delete;
+
+    ~PizzaBatch()
     {
-        return {new Garlic(), new Onion(), new Mushroom(), new RedPepper()};
+        for (Pizza *pizza : _placed)
+        {
+            pizza->~Pizza();
+        }
     }
-    Pepperoni *CreatePepperoni() override
+
+    size_t Size() const { return _results.size(); }
+    Pizza *operator[](size_t index) const { return _results[index]; }
+
+    template <typename Stage>
+    void ForEachPizza(Stage stage) const
     {
-        return new SlicedPepperoni();
+        for (Pizza *pizza : _grouped)
+        {
+            stage(*pizza);
+        }
     }
-    Clams *CreateClam() override
+
+private:
+    friend class PizzaCatalog;
+
+    struct AlignedDelete
     {
-        return new FrozenClams();
-    }
+        size_t alignment;
+        void operator()(std::byte *memory) const
+        {
+            ::operator delete(memory, std::align_val_t(alignment));
+        }
+    };
+
+    std::unique_ptr<std::byte[], AlignedDelete> _storage{nullptr, AlignedDelete{alignof(std::max_align_t)}};
+    std::vector<std::unique_ptr<Pizza>> _heap;
+    std::vector<Pizza *> _placed;
+    std::vector<Pizza *> _grouped;
+    std::vector<Pizza *> _results;
 };
 
-class CaliforniaPizzaIngredientFactory : public PizzaIngredientFactory
+class PizzaCatalog
 {
 public:
-    Dough *CreateDough() override
+    typedef PizzaMaker Maker;
+
+    template <typename P>
+    static Pizza *Make(const PizzaIngredientFactory &ingredientFactory)
     {
-        return new ThinCrustDough();
+        return new P(ingredientFactory);
     }
-    Sauce *CreateSauce() override
+
+    template <typename P>
+    static Pizza *Place(void *memory, const PizzaIngredientFactory &ingredientFactory)
     {
-        return new BruschettaSauce();
+        return new (memory) P(ingredientFactory);
     }
-    Cheese *CreateCheese() override
+
+    PizzaCatalog() : _slots(INITIAL_SLOTS) {}
+
+    void Register(std::string_view type, const std::string &name, Maker maker)
     {
-        return new GoatCheese();
+        PizzaTypeId id = PizzaType(type);
+        Entry &entry = Probe(id);
+        if (entry.maker && entry.type != type)
+        {
+            throw std::runtime_error("Pizza type id collision: " + std::string(type) + " and " + entry.type);
+        }
+        if (!entry.maker)
+        {
+            ++_count;
+        }
+        entry = Entry{id, std::string(type), PizzaNames().Intern(name), maker};
+        if (_count * 2 > _slots.size())
+        {
+            Grow();
+        }
     }
-    std::vector<Veggies *> CreateVeggies() override
+
+    template <typename P>
+    void Register(std::string_view type, const std::string &name)
     {
-        return {new Garlic(), new Onion(), new Mushroom(), new RedPepper()};
+        Register(type, name, Make<P>);
+        Entry &entry = Probe(PizzaType(type));
+        entry.placer = Place<P>;
+        entry.size = sizeof(P);
+        entry.alignment = alignof(P);
     }
-    Pepperoni *CreatePepperoni() override
+
+    Pizza *Create(PizzaTypeId id, const PizzaIngredientFactory &ingredientFactory) const
     {
-        return new SlicedPepperoni();
+        return Create(Probe(id), ingredientFactory);
     }
-    Clams *CreateClam() override
+
+    Pizza *Create(std::string_view type, const PizzaIngredientFactory &ingredientFactory) const
     {
-        return new FreshClams();
+        const Entry *entry = Find(type);
+        return entry ? Create(*entry, ingredientFactory) : nullptr;
     }
-};
 
-class NYPizzaStore : public PizzaStore
-{
-public:
-    NYPizzaStore() = default;
-    ~NYPizzaStore() override = default;
+    PooledPizza Acquire(std::string_view type, const PizzaIngredientFactory &ingredientFactory) const
+    {
+        const Entry *entry = Find(type);
+        if (!entry)
+            return PooledPizza();
+        PooledPizza pizza = PizzaPool::Acquire(entry->maker, ingredientFactory);
+        pizza->SetNameId(entry->name);
+        return pizza;
+    }
 
-protected:
-    Pizza *CreatePizza(const std::string &type) override
+    PizzaBatch CreateBatch(const OrderRequest *requests, size_t count, const PizzaIngredientFactory &ingredientFactory) const
     {
-        PizzaIngredientFactory *ingredientFactory = new NyPizzaIngredientFactory();
-        if (type == "cheese")
-        {
-            Pizza *pizza = new CheezePizza(ingredientFactory);
-            pizza->SetName("New York Style Cheese Pizza");
-            return pizza;
-        }
-        else if (type == "clam")
+        std::vector<const Entry *> groups;
+        std::vector<size_t> groupSizes;
+        std::vector<size_t> groupOf(count);
+        std::unordered_map<const Entry *, size_t> groupIndex;
+        size_t known = 0;
+        for (size_t i = 0; i < count; ++i)
         {
-            Pizza *pizza = new ClamPizza(ingredientFactory);
-            pizza->SetName("New York Style Clam Pizza");
-            return pizza;
+            const Entry *entry = Find(requests[i].type);
+            if (!entry)
+            {
+                groupOf[i] = SIZE_MAX;
+                continue;
+            }
+            auto [it, inserted] = groupIndex.try_emplace(entry, groups.size());
+            if (inserted)
+            {
+                groups.push_back(entry);
+                groupSizes.push_back(0);
+            }
+            groupOf[i] = it->second;
+            ++groupSizes[it->second];
+            ++known;
         }
-        else if (type == "veggie")
+
+        PizzaBatch batch;
+        std::vector<size_t> offsets(groups.size());
+        size_t bytes = 0;
+        size_t alignment = alignof(std::max_align_t);
+        for (size_t group = 0; group < groups.size(); ++group)
         {
-            Pizza *pizza = new VeggiePizza(ingredientFactory);
-            pizza->SetName("New York Style Veggie Pizza");
-            return pizza;
+            const Entry &entry = *groups[group];
+            if (!entry.placer)
+                continue;
+            bytes = (bytes + entry.alignment - 1) / entry.alignment * entry.alignment;
+            offsets[group] = bytes;
+            bytes += entry.size * groupSizes[group];
+            alignment = std::max<size_t>(alignment, entry.alignment);
         }
-        else
+        if (bytes)
         {
-            return nullptr;
+            batch._storage = std::unique_ptr<std::byte[], PizzaBatch::AlignedDelete>(
+                static_cast<std::byte *>(::operator new(bytes, std::align_val_t(alignment))), PizzaBatch::AlignedDelete{alignment});
         }
-    }
-};
-
-class ChicagoPizzaStore : public PizzaStore
-{
-public:
-    ChicagoPizzaStore() = default;
-    ~ChicagoPizzaStore() override = default;
 
-protected:
-    Pizza *CreatePizza(const std::string &type) override
-    {
-        PizzaIngredientFactory *ingredientFactory = new ChicagoPizzaIngredientFactory();
-        if (type == "cheese")
+        std::vector<size_t> order(known);
+        std::vector<size_t> next(groups.size());
+        for (size_t group = 1; group < groups.size(); ++group)
         {
-            Pizza *pizza = new CheezePizza(ingredientFactory);
-            pizza->SetName("Chicago Style Cheese Pizza");
-            return pizza;
+            next[group] = next[group - 1] + groupSizes[group - 1];
         }
-        else if (type == "pepperoni")
+        for (size_t i = 0; i < count; ++i)
         {
-            Pizza *pizza = new ClamPizza(ingredientFactory);
-            pizza->SetName("Chicago Style Pepperoni Pizza");
-            return pizza;
+            if (groupOf[i] != SIZE_MAX)
+                order[next[groupOf[i]]++] = i;
         }
-        else
+
+        batch._results.assign(count, nullptr);
+        batch._grouped.reserve(known);
+        batch._placed.reserve(known);
+        batch._heap.reserve(known);
+        std::vector<size_t> placed(groups.size());
+        for (size_t i : order)
         {
-            return nullptr;
+            size_t group = groupOf[i];
+            const Entry &entry = *groups[group];
+            Pizza *pizza;
+            if (entry.placer)
+            {
+                pizza = entry.placer(batch._storage.get() + offsets[group] + placed[group]++ * entry.size, ingredientFactory);
+                batch._placed.push_back(pizza);
+            }
+            else
+            {
+                pizza = entry.maker(ingredientFactory);
+                batch._heap.emplace_back(pizza);
+            }
+            pizza->SetNameId(entry.name);
+            batch._grouped.push_back(pizza);
+            batch._results[i] = pizza;
         }
+        return batch;
     }
-};
 
-class CaliforniaPizzaStore : public PizzaStore
-{
-public:
-    CaliforniaPizzaStore() = default;
-    ~CaliforniaPizzaStore() override = default;
+    bool Contains(std::string_view type) const { return Find(type) != nullptr; }
 
-protected:
-    Pizza *CreatePizza(const std::string &type) override
+    size_t Size() const { return _count; }
+
+private:
+    static const size_t INITIAL_SLOTS = 8;
+
+    struct Entry
     {
-        PizzaIngredientFactory *ingredientFactory = new CaliforniaPizzaIngredientFactory();
-        if (type == "cheese")
-        {
-            Pizza *pizza = new CheezePizza(ingredientFactory);
-            pizza->SetName("California Style Cheese Pizza");
-            return pizza;
-        }
-        else if (type == "pepperoni")
+        PizzaTypeId id = 0;
+        std::string type;
+        uint32_t name = 0;
+        Maker maker = nullptr;
+        PizzaPlacer placer = nullptr;
+        size_t size = 0;
+        size_t alignment = 0;
+    };
+
+    std::vector<Entry> _slots;
+    size_t _count = 0;
+
+    const Entry *Find(std::string_view type) const
+    {
+        const Entry &entry = Probe(PizzaType(type));
+        return entry.maker && entry.type == type ? &entry : nullptr;
+    }
+
+    static Pizza *Create(const Entry &entry, const PizzaIngredientFactory &ingredientFactory)
+    {
+        if (!entry.maker)
+            return nullptr;
+        Pizza *pizza = entry.maker(ingredientFactory);
+        pizza->SetNameId(entry.name);
+        return pizza;
+    }
+
+    size_t SlotOf(PizzaTypeId id) const
+    {
+        size_t mask = _slots.size() - 1;
+        size_t slot = id & mask;
+        while (_slots[slot].maker && _slots[slot].id != id)
         {
-            Pizza *pizza = new ClamPizza(ingredientFactory);
-            pizza->SetName("California Style Pepperoni Pizza");
-            return pizza;
+            slot = (slot + 1) & mask;
         }
-        else
+        return slot;
+    }
+
+    const Entry &Probe(PizzaTypeId id) const { return _slots[SlotOf(id)]; }
+    Entry &Probe(PizzaTypeId id) { return _slots[SlotOf(id)]; }
+
+    void Grow()
+    {
+        std::vector<Entry> old(_slots.size() * 2);
+        old.swap(_slots);
+        for (Entry &entry : old)
         {
-            return nullptr;
+            if (entry.maker)
+            {
+                _slots[SlotOf(entry.id)] = std::move(entry);
+            }
         }
     }
 };
 
-int main()
+class PizzaStore
 {
-    PizzaStore *nyStore = new NYPizzaStore();
-    PizzaStore *chicagoStore = new ChicagoPizzaStore();
-    PizzaStore *californiaStore = new CaliforniaPizzaStore();
+public:
+    PizzaStore(const PizzaIngredientFactory &ingredientFactory) : _ingredientFactory(ingredientFactory) {}
+    virtual ~PizzaStore() = default;
 
-    Pizza *pizza = nyStore->OrderPizza("cheese");
-    std::cout << "Ethan ordered a " << pizza->GetName() << "\n\n";
-    delete pizza;
+    Pizza *OrderPizza(const std::string &type)
+    {
+        return Finish(CreatePizza(type));
+    }
+
+    Pizza *OrderPizza(PizzaTypeId type)
+    {
+        return Finish(_catalog.Create(type, _ingredientFactory));
+    }
+
+    PooledPizza OrderPooledPizza(const std::string &type)
+    {
+        PooledPizza pizza = _catalog.Acquire(type, _ingredientFactory);
+        Finish(pizza.get());
+        return pizza;
+    }
+
+    bool Offers(std::string_view type) const
+    {
+        return _catalog.Contains(type);
+    }
+
+    PizzaBatch OrderPizzas(const OrderRequest *requests, size_t count)
+    {
+        PizzaBatch batch = _catalog.CreateBatch(requests, count, _ingredientFactory);
+        batch.ForEachPizza([](Pizza &pizza)
+                           { pizza.Prepare(); });
+        batch.ForEachPizza([](Pizza &pizza)
+                           { pizza.Bake(); });
+        batch.ForEachPizza([](Pizza &pizza)
+                           { pizza.Cut(); });
+        batch.ForEachPizza([](Pizza &pizza)
+                           { pizza.Box(); });
+        return batch;
+    }
+
+    PizzaBatch OrderPizzas(const std::vector<OrderRequest> &requests)
+    {
+        return OrderPizzas(requests.data(), requests.size());
+    }
+
+    // The catalog is read without locks by kitchen workers, so pizzas must be
+    // registered before any PizzaKitchen is started on this store.
+    void RegisterPizza(std::string_view type, const std::string &name, PizzaCatalog::Maker maker)
+    {
+        CheckNoKitchens();
+        _catalog.Register(type, name, maker);
+    }
+
+    template <typename P>
+    void RegisterPizza(std::string_view type, const std::string &name)
+    {
+        CheckNoKitchens();
+        _catalog.Register<P>(type, name);
+    }
+
+protected:
+    friend class PizzaKitchen;
+
+    const PizzaIngredientFactory &_ingredientFactory;
+    PizzaCatalog _catalog;
+
+    virtual Pizza *CreatePizza(const std::string &type)
+    {
+        return _catalog.Create(std::string_view(type), _ingredientFactory);
+    }
+
+private:
+    std::atomic<size_t> _kitchens{0};
+
+    void CheckNoKitchens() const
+    {
+        if (_kitchens.load())
+        {
+            throw std::runtime_error("Cannot register pizzas while a kitchen is running");
+        }
+    }
+
+    static Pizza *Finish(Pizza *pizza)
+    {
+        if (pizza)
+        {
+            pizza->Prepare();
+            pizza->Bake();
+            pizza->Cut();
+            pizza->Box();
+        }
+        return pizza;
+    }
+};
+
+template <typename Region, typename RegionDough, typename RegionSauce, typename RegionCheese, typename RegionClams>
+class RegionalIngredientFactory : public PizzaIngredientFactory
+{
+    struct Registry
+    {
+        const RegionDough dough;
+        const RegionSauce sauce;
+        const RegionCheese cheese;
+        const Garlic garlic;
+        const Onion onion;
+        const Mushroom mushroom;
+        const RedPepper redPepper;
+        const std::vector<const Veggies *> veggies{&garlic, &onion, &mushroom, &redPepper};
+        const SlicedPepperoni pepperoni;
+        const RegionClams clams;
+    };
+
+    static const Registry &GetRegistry()
+    {
+        static const Registry registry;
+        return registry;
+    }
+
+protected:
+    RegionalIngredientFactory() = default;
+
+public:
+    static const Region &GetInstance()
+    {
+        static const Region instance;
+        return instance;
+    }
+
+    RegionalIngredientFactory(const RegionalIngredientFactory &) = delete;
+    RegionalIngredientFactory &operator=(const RegionalIngredientFactory &) = delete;
+
+    const Dough *CreateDough() const override
+    {
+        return &GetRegistry().dough;
+    }
+    const Sauce *CreateSauce() const override
+    {
+        return &GetRegistry().sauce;
+    }
+    const Cheese *CreateCheese() const override
+    {
+        return &GetRegistry().cheese;
+    }
+    const std::vector<const Veggies *> &CreateVeggies() const override
+    {
+        return GetRegistry().veggies;
+    }
+    const Pepperoni *CreatePepperoni() const override
+    {
+        return &GetRegistry().pepperoni;
+    }
+    const Clams *CreateClam() const override
+    {
+        return &GetRegistry().clams;
+    }
+};
+
+class NyPizzaIngredientFactory
+    : public RegionalIngredientFactory<NyPizzaIngredientFactory, ThinCrustDough, MarinaraSauce, ReggianoCheese, FreshClams>
+{
+    friend class RegionalIngredientFactory;
+    NyPizzaIngredientFactory() = default;
+};
+
+class ChicagoPizzaIngredientFactory
+    : public RegionalIngredientFactory<ChicagoPizzaIngredientFactory, ThickCrustDough, PlumTomatoSauce, MozzarellaCheese, FrozenClams>
+{
+    friend class RegionalIngredientFactory;
+    ChicagoPizzaIngredientFactory() = default;
+};
+
+class CaliforniaPizzaIngredientFactory
+    : public RegionalIngredientFactory<CaliforniaPizzaIngredientFactory, ThinCrustDough, BruschettaSauce, GoatCheese, FreshClams>
+{
+    friend class RegionalIngredientFactory;
+    CaliforniaPizzaIngredientFactory() = default;
+};
+
+class NYPizzaStore : public PizzaStore
+{
+public:
+    NYPizzaStore() : PizzaStore(NyPizzaIngredientFactory::GetInstance())
+    {
+        RegisterPizza<CheezePizza>("cheese", "New York Style Cheese Pizza");
+        RegisterPizza<ClamPizza>("clam", "New York Style Clam Pizza");
+        RegisterPizza<VeggiePizza>("veggie", "New York Style Veggie Pizza");
+    }
+    ~NYPizzaStore() override = default;
+};
+
+class ChicagoPizzaStore : public PizzaStore
+{
+public:
+    ChicagoPizzaStore() : PizzaStore(ChicagoPizzaIngredientFactory::GetInstance())
+    {
+        RegisterPizza<CheezePizza>("cheese", "Chicago Style Cheese Pizza");
+        RegisterPizza<ClamPizza>("pepperoni", "Chicago Style Pepperoni Pizza");
+    }
+    ~ChicagoPizzaStore() override = default;
+};
+
+class CaliforniaPizzaStore : public PizzaStore
+{
+public:
+    CaliforniaPizzaStore() : PizzaStore(CaliforniaPizzaIngredientFactory::GetInstance())
+    {
+        RegisterPizza<CheezePizza>("cheese", "California Style Cheese Pizza");
+        RegisterPizza<ClamPizza>("pepperoni", "California Style Pepperoni Pizza");
+    }
+    ~CaliforniaPizzaStore() override = default;
+};
+
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : _capacity(std::max<size_t>(1, capacity)) {}
+
+    bool Push(T &item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notFull.wait(lock, [this]
+                      { return _closed || _items.size() < _capacity; });
+        if (_closed)
+            return false;
+        _items.push_back(std::move(item));
+        _highWater = std::max(_highWater, _items.size());
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    std::optional<T> Pop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _notEmpty.wait(lock, [this]
+                       { return _closed || !_items.empty(); });
+        if (_items.empty())
+            return std::nullopt;
+        T item = std::move(_items.front());
+        _items.pop_front();
+        _notFull.notify_one();
+        return item;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        _notEmpty.notify_all();
+        _notFull.notify_all();
+    }
+
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.size();
+    }
+
+    size_t HighWater() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _highWater;
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    std::deque<T> _items;
+    size_t _capacity;
+    size_t _highWater = 0;
+    bool _closed = false;
+};
+
+struct KitchenConfig
+{
+    size_t prepWorkers = 1;
+    size_t bakeWorkers = 2;
+    size_t cutWorkers = 1;
+    size_t boxWorkers = 1;
+    size_t queueCapacity = 64;
+};
+
+struct KitchenStageStats
+{
+    std::string name;
+    size_t workers;
+    size_t processed;
+    double busySeconds;
+    double utilization;
+    size_t queueDepth;
+    size_t maxQueueDepth;
+};
+
+struct KitchenStats
+{
+    size_t completed;
+    size_t callbackFailures;
+    double elapsedSeconds;
+    double ordersPerSecond;
+    std::vector<KitchenStageStats> stages;
+};
+
+class PizzaKitchen
+{
+public:
+    typedef std::function<void(Pizza *, std::exception_ptr)> Callback;
+
+    PizzaKitchen(PizzaStore &store, const KitchenConfig &config = KitchenConfig())
+        : _store(store), _started(std::chrono::steady_clock::now())
+    {
+        ++_store._kitchens;
+        const char *names[] = {"prepare", "bake", "cut", "box"};
+        size_t workers[] = {config.prepWorkers, config.bakeWorkers, config.cutWorkers, config.boxWorkers};
+        for (size_t i = 0; i < STAGE_COUNT; ++i)
+        {
+            _stages[i].name = names[i];
+            _stages[i].queue = std::make_unique<BoundedQueue<std::unique_ptr<Ticket>>>(config.queueCapacity);
+        }
+        for (size_t i = 0; i < STAGE_COUNT; ++i)
+        {
+            for (size_t worker = 0; worker < std::max<size_t>(1, workers[i]); ++worker)
+            {
+                _stages[i].workers.emplace_back([this, i]
+                                                { RunStage(i); });
+            }
+        }
+    }
+
+    ~PizzaKitchen()
+    {
+        for (Stage &stage : _stages)
+        {
+            stage.queue->Close();
+            for (std::thread &worker : stage.workers)
+            {
+                worker.join();
+            }
+        }
+        --_store._kitchens;
+    }
+
+    PizzaKitchen(const PizzaKitchen &) = delete;
+    PizzaKitchen &operator=(const PizzaKitchen &) = delete;
+
+    std::future<Pizza *> Submit(const std::string &type)
+    {
+        auto ticket = std::make_unique<Ticket>();
+        ticket->type = type;
+        std::future<Pizza *> result = ticket->promise.get_future();
+        Enqueue(std::move(ticket));
+        return result;
+    }
+
+    void Submit(const std::string &type, Callback callback)
+    {
+        auto ticket = std::make_unique<Ticket>();
+        ticket->type = type;
+        ticket->callback = std::move(callback);
+        Enqueue(std::move(ticket));
+    }
+
+    KitchenStats GetStats() const
+    {
+        KitchenStats stats;
+        stats.completed = _completed.load();
+        stats.callbackFailures = _callbackFailures.load();
+        stats.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _started).count();
+        stats.ordersPerSecond = stats.elapsedSeconds > 0 ? stats.completed / stats.elapsedSeconds : 0;
+        for (const Stage &stage : _stages)
+        {
+            KitchenStageStats stageStats;
+            stageStats.name = stage.name;
+            stageStats.workers = stage.workers.size();
+            stageStats.processed = stage.processed.load();
+            stageStats.busySeconds = stage.busyNanos.load() / 1e9;
+            stageStats.utilization = stats.elapsedSeconds > 0 ? stageStats.busySeconds / (stageStats.workers * stats.elapsedSeconds) : 0;
+            stageStats.queueDepth = stage.queue->Size();
+            stageStats.maxQueueDepth = stage.queue->HighWater();
+            stats.stages.push_back(stageStats);
+        }
+        return stats;
+    }
+
+private:
+    static const size_t STAGE_COUNT = 4;
+
+    struct Ticket
+    {
+        std::string type;
+        Pizza *pizza = nullptr;
+        std::promise<Pizza *> promise;
+        Callback callback;
+    };
+
+    struct Stage
+    {
+        std::string name;
+        std::unique_ptr<BoundedQueue<std::unique_ptr<Ticket>>> queue;
+        std::vector<std::thread> workers;
+        std::atomic<size_t> processed{0};
+        std::atomic<uint64_t> busyNanos{0};
+    };
+
+    PizzaStore &_store;
+    std::chrono::steady_clock::time_point _started;
+    std::atomic<size_t> _completed{0};
+    std::atomic<size_t> _callbackFailures{0};
+    Stage _stages[STAGE_COUNT];
+
+    void Enqueue(std::unique_ptr<Ticket> ticket)
+    {
+        if (!_stages[0].queue->Push(ticket))
+        {
+            throw std::runtime_error("Kitchen is closed");
+        }
+    }
+
+    void Complete(Ticket &ticket, std::exception_ptr error = nullptr)
+    {
+        if (error)
+        {
+            delete ticket.pizza;
+            ticket.pizza = nullptr;
+        }
+        if (ticket.callback)
+        {
+            try
+            {
+                ticket.callback(ticket.pizza, error);
+            }
+            catch (...)
+            {
+                ++_callbackFailures;
+            }
+        }
+        else if (error)
+        {
+            ticket.promise.set_exception(error);
+        }
+        else
+        {
+            ticket.promise.set_value(ticket.pizza);
+        }
+        ++_completed;
+    }
+
+    void Work(size_t stage, Ticket &ticket)
+    {
+        switch (stage)
+        {
+        case 0:
+            ticket.pizza = _store.CreatePizza(ticket.type);
+            if (ticket.pizza)
+                ticket.pizza->Prepare();
+            break;
+        case 1:
+            ticket.pizza->Bake();
+            break;
+        case 2:
+            ticket.pizza->Cut();
+            break;
+        default:
+            ticket.pizza->Box();
+            break;
+        }
+    }
+
+    void RunStage(size_t index)
+    {
+        Stage &stage = _stages[index];
+        while (std::optional<std::unique_ptr<Ticket>> ticket = stage.queue->Pop())
+        {
+            auto begin = std::chrono::steady_clock::now();
+            std::exception_ptr error;
+            try
+            {
+                Work(index, **ticket);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            stage.busyNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+            ++stage.processed;
+            if (error || !(*ticket)->pizza || index + 1 == STAGE_COUNT)
+            {
+                Complete(**ticket, error);
+            }
+            else if (!_stages[index + 1].queue->Push(*ticket))
+            {
+                Complete(**ticket, std::make_exception_ptr(std::runtime_error("Kitchen is closed")));
+            }
+        }
+    }
+};
+
+enum class KitchenPolicy
+{
+    Fifo,
+    ShortestBakeFirst,
+    Priority
+};
+
+struct SimulatedPizza
+{
+    std::string type;
+    double prepMinutes;
+    double bakeMinutes;
+    double boxMinutes;
+    double share;
+};
+
+struct SimulationConfig
+{
+    std::vector<SimulatedPizza> menu;
+    KitchenPolicy policy = KitchenPolicy::Fifo;
+    size_t prepStations = 2;
+    size_t ovens = 3;
+    size_t boxers = 1;
+    size_t stores = 500;
+    size_t days = 365;
+    double openHours = 12;
+    double ordersPerHour = 20;
+    double priorityShare = 0.1;
+    uint64_t seed = 1;
+};
+
+struct ResourceUtilization
+{
+    std::string name;
+    size_t units;
+    double busyMinutes;
+    double openHoursUtilization;
+    double allDayUtilization;
+};
+
+struct MinutesSummary
+{
+    double mean = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+struct SimulationReport
+{
+    size_t orders = 0;
+    size_t completed = 0;
+    double simulatedMinutes = 0;
+    double ordersPerStoreHour = 0;
+    double capacityPerStoreHour = 0;
+    double meanBacklogAtClose = 0;
+    size_t maxBacklogAtClose = 0;
+    MinutesSummary queueDelay;
+    MinutesSummary turnaround;
+    std::vector<ResourceUtilization> resources;
+};
+
+class KitchenSimulator
+{
+public:
+    KitchenSimulator(const PizzaStore &store, const SimulationConfig &config) : _config(config)
+    {
+        if (_config.menu.empty())
+        {
+            throw std::runtime_error("Simulation menu is empty");
+        }
+        double totalShare = 0;
+        for (const SimulatedPizza &pizza : _config.menu)
+        {
+            if (!store.Offers(pizza.type))
+            {
+                throw std::runtime_error("Store does not offer pizza type: " + pizza.type);
+            }
+            if (!IsPositive(pizza.prepMinutes) || !IsPositive(pizza.bakeMinutes) || !IsPositive(pizza.boxMinutes))
+            {
+                throw std::runtime_error("Stage minutes must be positive for pizza type: " + pizza.type);
+            }
+            if (!(pizza.share >= 0) || !std::isfinite(pizza.share))
+            {
+                throw std::runtime_error("Order share must be a non-negative number for pizza type: " + pizza.type);
+            }
+            totalShare += pizza.share;
+        }
+        if (!IsPositive(totalShare))
+        {
+            throw std::runtime_error("Simulation menu shares are all zero");
+        }
+        if (_config.prepStations == 0 || _config.ovens == 0 || _config.boxers == 0)
+        {
+            throw std::runtime_error("Kitchen needs at least one prep station, oven and boxer");
+        }
+        if (_config.stores == 0 || _config.days == 0)
+        {
+            throw std::runtime_error("Simulation needs at least one store and one day");
+        }
+        if (!IsPositive(_config.openHours) || _config.openHours > 24)
+        {
+            throw std::runtime_error("Open hours must be positive and at most 24");
+        }
+        if (!IsPositive(_config.ordersPerHour))
+        {
+            throw std::runtime_error("Orders per hour must be positive");
+        }
+        if (!(_config.priorityShare >= 0 && _config.priorityShare <= 1))
+        {
+            throw std::runtime_error("Priority share must be between 0 and 1");
+        }
+    }
+
+    SimulationReport Run(size_t threads = std::max(1u, std::thread::hardware_concurrency())) const
+    {
+        std::vector<StoreResult> results(_config.stores);
+        std::vector<Distributions> distributions(std::max<size_t>(1, std::min(threads, _config.stores)));
+        std::atomic<size_t> nextStore{0};
+        std::vector<std::thread> workers;
+        for (Distributions &worker : distributions)
+        {
+            workers.emplace_back([this, &results, &nextStore, &worker]
+                                 {
+                                     for (size_t store = nextStore++; store < results.size(); store = nextStore++)
+                                     {
+                                         results[store] = SimulateStore(store, worker);
+                                     } });
+        }
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        return Summarize(results, distributions);
+    }
+
+private:
+    static constexpr size_t STAGE_COUNT = 3;
+    static constexpr double MINUTES_PER_DAY = 24 * 60;
+    static constexpr double HISTOGRAM_RESOLUTION = 0.1;
+    static constexpr size_t HISTOGRAM_BINS = 24 * 60 * 10;
+
+    struct Order
+    {
+        double arrival;
+        double queuedAt;
+        double queued;
+        double waitingKey;
+        uint32_t pizza;
+    };
+
+    struct Event
+    {
+        double time;
+        uint64_t sequence;
+        uint32_t order;
+        uint8_t stage;
+
+        bool operator>(const Event &other) const
+        {
+            return time != other.time ? time > other.time : sequence > other.sequence;
+        }
+    };
+
+    struct Waiting
+    {
+        double key;
+        uint64_t sequence;
+        uint32_t order;
+
+        bool operator>(const Waiting &other) const
+        {
+            return key != other.key ? key > other.key : sequence > other.sequence;
+        }
+    };
+
+    typedef std::priority_queue<Event, std::vector<Event>, std::greater<Event>> EventQueue;
+
+    class WaitingQueue
+    {
+        std::priority_queue<Waiting, std::vector<Waiting>, std::greater<Waiting>> _ordered;
+        std::deque<uint32_t> _line;
+        bool _fifo;
+
+    public:
+        explicit WaitingQueue(bool fifo = true) : _fifo(fifo) {}
+
+        bool Empty() const { return _fifo ? _line.empty() : _ordered.empty(); }
+
+        void Push(double key, uint64_t sequence, uint32_t order)
+        {
+            if (_fifo)
+                _line.push_back(order);
+            else
+                _ordered.push(Waiting{key, sequence, order});
+        }
+
+        uint32_t Pop()
+        {
+            uint32_t order;
+            if (_fifo)
+            {
+                order = _line.front();
+                _line.pop_front();
+            }
+            else
+            {
+                order = _ordered.top().order;
+                _ordered.pop();
+            }
+            return order;
+        }
+    };
+
+    static constexpr uint8_t ARRIVAL = STAGE_COUNT;
+
+    class MinutesHistogram
+    {
+        std::vector<uint64_t> _counts = std::vector<uint64_t>(HISTOGRAM_BINS + 1, 0);
+
+    public:
+        void Add(double minutes)
+        {
+            ++_counts[std::min(HISTOGRAM_BINS, static_cast<size_t>(minutes / HISTOGRAM_RESOLUTION))];
+        }
+
+        void Merge(const MinutesHistogram &other)
+        {
+            for (size_t bin = 0; bin < _counts.size(); ++bin)
+            {
+                _counts[bin] += other._counts[bin];
+            }
+        }
+
+        double Percentile(size_t count, double quantile, double maximum) const
+        {
+            uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * count));
+            uint64_t seen = 0;
+            for (size_t bin = 0; bin < _counts.size(); ++bin)
+            {
+                seen += _counts[bin];
+                if (seen >= rank && seen > 0)
+                {
+                    return bin == HISTOGRAM_BINS ? maximum : std::min(maximum, (bin + 1) * HISTOGRAM_RESOLUTION);
+                }
+            }
+            return maximum;
+        }
+    };
+
+    struct Distributions
+    {
+        MinutesHistogram queueDelay;
+        MinutesHistogram turnaround;
+    };
+
+    struct StoreResult
+    {
+        size_t orders = 0;
+        size_t completed = 0;
+        double endTime = 0;
+        double queueSum = 0;
+        double queueMax = 0;
+        double turnaroundSum = 0;
+        double turnaroundMax = 0;
+        double busy[STAGE_COUNT] = {};
+        double openBusy[STAGE_COUNT] = {};
+        size_t backlogSum = 0;
+        size_t backlogMax = 0;
+    };
+
+    SimulationConfig _config;
+
+    static bool IsPositive(double value)
+    {
+        return value > 0 && std::isfinite(value);
+    }
+
+    static double StageMinutes(const SimulatedPizza &pizza, size_t stage)
+    {
+        return stage == 0 ? pizza.prepMinutes : stage == 1 ? pizza.bakeMinutes : pizza.boxMinutes;
+    }
+
+    double OpenMinutesBetween(double start, double end) const
+    {
+        double openMinutes = _config.openHours * 60;
+        double day = std::floor(start / MINUTES_PER_DAY);
+        double opens = day * MINUTES_PER_DAY;
+        if (end <= opens + MINUTES_PER_DAY)
+        {
+            return day < _config.days ? std::max(0.0, std::min(end, opens + openMinutes) - start) : 0;
+        }
+        double overlap = 0;
+        for (; day < _config.days && opens < end; ++day, opens += MINUTES_PER_DAY)
+        {
+            overlap += std::max(0.0, std::min(end, opens + openMinutes) - std::max(start, opens));
+        }
+        return overlap;
+    }
+
+    // Sustained completions per open hour if every order arrived during opening
+    // hours: each stage finishes units / (mean minutes per order) orders a
+    // minute, and the slowest stage bounds the kitchen.
+    double CapacityPerHour() const
+    {
+        double totalShare = 0;
+        double meanMinutes[STAGE_COUNT] = {};
+        for (const SimulatedPizza &pizza : _config.menu)
+        {
+            totalShare += pizza.share;
+            for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+            {
+                meanMinutes[stage] += pizza.share * StageMinutes(pizza, stage);
+            }
+        }
+        size_t units[STAGE_COUNT] = {_config.prepStations, _config.ovens, _config.boxers};
+        double capacity = std::numeric_limits<double>::infinity();
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+        {
+            capacity = std::min(capacity, units[stage] * 60 / (meanMinutes[stage] / totalShare));
+        }
+        return capacity;
+    }
+
+    StoreResult SimulateStore(size_t store, Distributions &distributions) const
+    {
+        std::mt19937_64 random(_config.seed * 1000003 + store);
+        std::exponential_distribution<double> interArrival(_config.ordersPerHour / 60);
+        std::vector<double> shares;
+        for (const SimulatedPizza &pizza : _config.menu)
+        {
+            shares.push_back(pizza.share);
+        }
+        std::discrete_distribution<uint32_t> pickPizza(shares.begin(), shares.end());
+        std::bernoulli_distribution pickPriority(_config.priorityShare);
+
+        struct PizzaTiming
+        {
+            double minutes[STAGE_COUNT];
+            double bakeKey;
+        };
+        std::vector<PizzaTiming> timings;
+        for (const SimulatedPizza &pizza : _config.menu)
+        {
+            timings.push_back(PizzaTiming{{pizza.prepMinutes, pizza.bakeMinutes, pizza.boxMinutes},
+                                          _config.policy == KitchenPolicy::ShortestBakeFirst ? pizza.bakeMinutes : 0});
+        }
+
+        bool fifo = _config.policy == KitchenPolicy::Fifo;
+        size_t idle[STAGE_COUNT] = {_config.prepStations, _config.ovens, _config.boxers};
+        WaitingQueue waiting[STAGE_COUNT] = {WaitingQueue(fifo), WaitingQueue(fifo), WaitingQueue(fifo)};
+        EventQueue events;
+        std::vector<Order> orders;
+        uint64_t sequence = 0;
+        StoreResult result;
+
+        // Only one arrival is ever pending, so it is kept beside the event
+        // queue instead of going through it.
+        std::optional<Event> arrival;
+        double openMinutes = _config.openHours * 60;
+        size_t day = 0;
+        double clock = 0;
+        auto scheduleArrival = [&]()
+        {
+            clock += interArrival(random);
+            while (clock >= openMinutes && day < _config.days)
+            {
+                clock -= openMinutes;
+                ++day;
+            }
+            arrival.reset();
+            if (day < _config.days)
+            {
+                arrival = Event{day * MINUTES_PER_DAY + clock, sequence++, 0, ARRIVAL};
+            }
+        };
+        auto begin = [&](size_t stage, uint32_t order, double now)
+        {
+            --idle[stage];
+            orders[order].queued += now - orders[order].queuedAt;
+            double minutes = timings[orders[order].pizza].minutes[stage];
+            result.busy[stage] += minutes;
+            result.openBusy[stage] += OpenMinutesBetween(now, now + minutes);
+            events.push(Event{now + minutes, sequence++, order, static_cast<uint8_t>(stage)});
+        };
+        auto startWork = [&](size_t stage, double now)
+        {
+            while (idle[stage] > 0 && !waiting[stage].Empty())
+            {
+                begin(stage, waiting[stage].Pop(), now);
+            }
+        };
+        auto enqueue = [&](size_t stage, uint32_t order, double now)
+        {
+            orders[order].queuedAt = now;
+            if (idle[stage] > 0 && waiting[stage].Empty())
+            {
+                begin(stage, order, now);
+                return;
+            }
+            waiting[stage].Push(orders[order].waitingKey, sequence++, order);
+            startWork(stage, now);
+        };
+
+        scheduleArrival();
+        std::vector<uint32_t> freeOrders;
+        size_t closingDay = 0;
+        double closesAt = openMinutes;
+        while (arrival || !events.empty())
+        {
+            Event event;
+            if (arrival && (events.empty() || events.top() > *arrival))
+            {
+                event = *arrival;
+            }
+            else
+            {
+                event = events.top();
+                events.pop();
+            }
+            result.endTime = event.time;
+            while (closingDay < _config.days && event.time >= closesAt)
+            {
+                size_t backlog = result.orders - result.completed;
+                result.backlogSum += backlog;
+                result.backlogMax = std::max(result.backlogMax, backlog);
+                ++closingDay;
+                closesAt += MINUTES_PER_DAY;
+            }
+            if (event.stage == ARRIVAL)
+            {
+                uint32_t order;
+                if (freeOrders.empty())
+                {
+                    order = static_cast<uint32_t>(orders.size());
+                    orders.emplace_back();
+                }
+                else
+                {
+                    order = freeOrders.back();
+                    freeOrders.pop_back();
+                }
+                uint32_t pizza = pickPizza(random);
+                double key = timings[pizza].bakeKey;
+                if (_config.policy == KitchenPolicy::Priority)
+                {
+                    key = pickPriority(random) ? -1 : 0;
+                }
+                orders[order] = Order{event.time, event.time, 0, key, pizza};
+                ++result.orders;
+                enqueue(0, order, event.time);
+                scheduleArrival();
+                continue;
+            }
+            ++idle[event.stage];
+            if (event.stage + 1u < STAGE_COUNT)
+            {
+                enqueue(event.stage + 1, event.order, event.time);
+            }
+            else
+            {
+                const Order &done = orders[event.order];
+                double turnaround = event.time - done.arrival;
+                ++result.completed;
+                result.queueSum += done.queued;
+                result.queueMax = std::max(result.queueMax, done.queued);
+                result.turnaroundSum += turnaround;
+                result.turnaroundMax = std::max(result.turnaroundMax, turnaround);
+                distributions.queueDelay.Add(done.queued);
+                distributions.turnaround.Add(turnaround);
+                freeOrders.push_back(event.order);
+            }
+            startWork(event.stage, event.time);
+        }
+        return result;
+    }
+
+    static MinutesSummary Summarize(const MinutesHistogram &histogram, size_t count, double sum, double maximum)
+    {
+        MinutesSummary summary;
+        if (count == 0)
+        {
+            return summary;
+        }
+        summary.mean = sum / count;
+        summary.p50 = histogram.Percentile(count, 0.50, maximum);
+        summary.p90 = histogram.Percentile(count, 0.90, maximum);
+        summary.p99 = histogram.Percentile(count, 0.99, maximum);
+        summary.max = maximum;
+        return summary;
+    }
+
+    SimulationReport Summarize(const std::vector<StoreResult> &results, const std::vector<Distributions> &distributions) const
+    {
+        SimulationReport report;
+        Distributions merged;
+        for (const Distributions &worker : distributions)
+        {
+            merged.queueDelay.Merge(worker.queueDelay);
+            merged.turnaround.Merge(worker.turnaround);
+        }
+        double queueSum = 0;
+        double queueMax = 0;
+        double turnaroundSum = 0;
+        double turnaroundMax = 0;
+        double busy[STAGE_COUNT] = {};
+        double openBusy[STAGE_COUNT] = {};
+        size_t backlogSum = 0;
+        double horizon = _config.days * MINUTES_PER_DAY;
+        for (const StoreResult &result : results)
+        {
+            report.orders += result.orders;
+            report.completed += result.completed;
+            queueSum += result.queueSum;
+            queueMax = std::max(queueMax, result.queueMax);
+            turnaroundSum += result.turnaroundSum;
+            turnaroundMax = std::max(turnaroundMax, result.turnaroundMax);
+            horizon = std::max(horizon, result.endTime);
+            backlogSum += result.backlogSum;
+            report.maxBacklogAtClose = std::max(report.maxBacklogAtClose, result.backlogMax);
+            for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+            {
+                busy[stage] += result.busy[stage];
+                openBusy[stage] += result.openBusy[stage];
+            }
+        }
+        report.simulatedMinutes = horizon;
+        double storeOpenMinutes = results.size() * _config.days * _config.openHours * 60;
+        report.ordersPerStoreHour = report.completed / (storeOpenMinutes / 60);
+        report.capacityPerStoreHour = CapacityPerHour();
+        report.meanBacklogAtClose = static_cast<double>(backlogSum) / (results.size() * _config.days);
+        report.queueDelay = Summarize(merged.queueDelay, report.completed, queueSum, queueMax);
+        report.turnaround = Summarize(merged.turnaround, report.completed, turnaroundSum, turnaroundMax);
+
+        const char *names[STAGE_COUNT] = {"prep stations", "ovens", "boxers"};
+        size_t units[STAGE_COUNT] = {_config.prepStations, _config.ovens, _config.boxers};
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+        {
+            report.resources.push_back(ResourceUtilization{names[stage], units[stage], busy[stage],
+                                                           openBusy[stage] / (units[stage] * storeOpenMinutes),
+                                                           busy[stage] / (units[stage] * horizon * results.size())});
+        }
+        return report;
+    }
+};
+
+std::atomic<size_t> allocationCount{0};
+
+void *operator new(size_t size)
+{
+    ++allocationCount;
+    if (void *memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t alignment)
+{
+    ++allocationCount;
+    size_t align = static_cast<size_t>(alignment);
+    if (void *memory = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+        return memory;
+    throw std::bad_alloc();
+}
+
+// Kept out of line so that GCC does not pair the inlined free with the
+// replaced operator new and warn about a mismatch.
+[[gnu::noinline]] void operator delete(void *memory) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+
+class QuietOutput
+{
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+    };
+
+    NullBuffer _buffer;
+    std::streambuf *_previous;
+
+public:
+    QuietOutput() : _previous(std::cout.rdbuf(&_buffer)) {}
+    ~QuietOutput() { std::cout.rdbuf(_previous); }
+};
+
+struct BenchmarkRun
+{
+    double seconds;
+    size_t allocations;
+};
+
+template <typename F>
+BenchmarkRun Measure(F &&work)
+{
+    size_t allocations = allocationCount.load();
+    auto begin = std::chrono::steady_clock::now();
+    {
+        QuietOutput quiet;
+        work();
+    }
+    return BenchmarkRun{std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(),
+                        allocationCount.load() - allocations};
+}
+
+void BenchmarkOrders(size_t orders)
+{
+    NYPizzaStore store;
+    const char *types[] = {"cheese", "clam", "veggie"};
+    BenchmarkRun run = Measure([&]
+                               {
+                                   for (size_t i = 0; i < orders; ++i)
+                                   {
+                                       delete store.OrderPizza(types[i % 3]);
+                                   } });
+    std::cout << "orders: " << orders << " OrderPizza calls, " << orders / run.seconds << " orders/s, "
+              << static_cast<double>(run.allocations) / orders << " allocations per order\n";
+}
+
+void BenchmarkRegions(size_t orders)
+{
+    NYPizzaStore ny;
+    ChicagoPizzaStore chicago;
+    CaliforniaPizzaStore california;
+    PizzaStore *stores[] = {&ny, &chicago, &california};
+    BenchmarkRun run = Measure([&]
+                               {
+                                   for (size_t i = 0; i < orders; ++i)
+                                   {
+                                       delete stores[i % 3]->OrderPizza("cheese");
+                                   } });
+    std::cout << "regions: " << orders << " OrderPizza calls across three regional stores, " << orders / run.seconds
+              << " orders/s, " << static_cast<double>(run.allocations) / orders << " allocations per order\n";
+}
+
+void BenchmarkKitchen(size_t orders)
+{
+    NYPizzaStore store;
+    const char *types[] = {"cheese", "clam", "veggie"};
+    for (size_t bakeWorkers : {1, 2, 4})
+    {
+        KitchenConfig config;
+        config.bakeWorkers = bakeWorkers;
+        KitchenStats stats;
+        std::atomic<size_t> done{0};
+        Measure([&]
+                {
+                    PizzaKitchen kitchen(store, config);
+                    for (size_t i = 0; i < orders; ++i)
+                    {
+                        kitchen.Submit(types[i % 3], [&done](Pizza *pizza, std::exception_ptr)
+                                       {
+                                           delete pizza;
+                                           ++done; });
+                    }
+                    while (done.load() < orders)
+                    {
+                        std::this_thread::yield();
+                    }
+                    stats = kitchen.GetStats(); });
+        std::cout << "kitchen: " << bakeWorkers << " bake workers, " << stats.completed << " orders, "
+                  << stats.ordersPerSecond << " orders/s\n";
+        for (const KitchenStageStats &stage : stats.stages)
+        {
+            std::cout << "  " << stage.name << ": " << stage.workers << " workers, " << stage.utilization * 100
+                      << "% busy, max queue depth " << stage.maxQueueDepth << "\n";
+        }
+    }
+}
+
+void BenchmarkDispatch(size_t lookups)
+{
+    const size_t TYPES = 200;
+    PizzaCatalog catalog;
+    std::vector<std::string> types;
+    for (size_t i = 0; i < TYPES; ++i)
+    {
+        types.push_back("style" + std::to_string(i));
+        catalog.Register<CheezePizza>(types.back(), "Style " + std::to_string(i) + " Pizza");
+    }
+    std::vector<PizzaTypeId> ids;
+    for (const std::string &type : types)
+    {
+        ids.push_back(PizzaType(type));
+    }
+    size_t found = 0;
+    BenchmarkRun chain = Measure([&]
+                                 {
+                                     for (size_t i = 0; i < lookups; ++i)
+                                     {
+                                         const std::string &type = types[i * 7919 % TYPES];
+                                         for (const std::string &candidate : types)
+                                         {
+                                             if (type == candidate)
+                                             {
+                                                 ++found;
+                                                 break;
+                                             }
+                                         }
+                                     } });
+    BenchmarkRun byName = Measure([&]
+                                  {
+                                      for (size_t i = 0; i < lookups; ++i)
+                                      {
+                                          found += catalog.Contains(types[i * 7919 % TYPES]);
+                                      } });
+    const NyPizzaIngredientFactory &factory = NyPizzaIngredientFactory::GetInstance();
+    BenchmarkRun byId = Measure([&]
+                                {
+                                    for (size_t i = 0; i < lookups; ++i)
+                                    {
+                                        delete catalog.Create(ids[i * 7919 % TYPES], factory);
+                                    } });
+    std::cout << "dispatch: " << TYPES << " types, " << lookups << " lookups (" << found << " hits)\n"
+              << "  string comparison chain: " << chain.seconds * 1e9 / lookups << " ns per lookup\n"
+              << "  catalog lookup by name: " << byName.seconds * 1e9 / lookups << " ns per lookup\n"
+              << "  catalog create by id: " << byId.seconds * 1e9 / lookups << " ns per pizza, including new and delete\n";
+}
+
+void BenchmarkPizzaMemory(size_t orders)
+{
+    NYPizzaStore store;
+    std::vector<std::unique_ptr<Pizza>> pizzas;
+    pizzas.reserve(orders);
+    size_t bytes = mallinfo2().uordblks;
+    BenchmarkRun heap = Measure([&]
+                                {
+                                    for (size_t i = 0; i < orders; ++i)
+                                    {
+                                        pizzas.emplace_back(store.OrderPizza("veggie"));
+                                    } });
+    bytes = mallinfo2().uordblks - bytes;
+    std::vector<PizzaValue> values;
+    values.reserve(orders);
+    BenchmarkRun copy = Measure([&]
+                                {
+                                    for (const std::unique_ptr<Pizza> &pizza : pizzas)
+                                    {
+                                        values.push_back(pizza->GetValue());
+                                    } });
+    std::cout << "pizza-memory: " << orders << " veggie pizzas, " << sizeof(PizzaValue) << "-byte PizzaValue, "
+              << static_cast<double>(bytes) / orders << " live heap bytes and " << static_cast<double>(heap.allocations) / orders
+              << " allocations per ordered pizza, " << copy.seconds * 1e9 / orders << " ns per value copied into a batch\n";
+}
+
+void BenchmarkPooling(size_t orders)
+{
+    NYPizzaStore store;
+    const std::string types[] = {"cheese", "clam", "veggie"};
+    std::vector<double> latencies(orders);
+    auto report = [&](const char *mode, const BenchmarkRun &run)
+    {
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "  " << mode << ": " << static_cast<double>(run.allocations) / orders << " allocations per order, p50 "
+                  << latencies[orders / 2] << " ns, p99 " << latencies[orders * 99 / 100] << " ns, "
+                  << orders / run.seconds << " orders/s\n";
+    };
+    std::cout << "pooling: " << orders << " orders\n";
+    report("new/delete", Measure([&]
+                                 {
+                                     for (size_t i = 0; i < orders; ++i)
+                                     {
+                                         auto begin = std::chrono::steady_clock::now();
+                                         delete store.OrderPizza(types[i % 3]);
+                                         latencies[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+                                     } }));
+    report("pooled", Measure([&]
+                             {
+                                 for (size_t i = 0; i < orders; ++i)
+                                 {
+                                     auto begin = std::chrono::steady_clock::now();
+                                     store.OrderPooledPizza(types[i % 3]);
+                                     latencies[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+                                 } }));
+}
+
+void BenchmarkBatches(size_t orders)
+{
+    NYPizzaStore store;
+    const char *types[] = {"cheese", "clam", "veggie"};
+    std::cout << "batches: " << orders << " orders per batch size\n";
+    for (size_t batchSize : {1, 16, 256, 4096})
+    {
+        std::vector<OrderRequest> requests;
+        for (size_t i = 0; i < batchSize; ++i)
+        {
+            requests.push_back(OrderRequest{types[i % 3]});
+        }
+        size_t batches = std::max<size_t>(1, orders / batchSize);
+        BenchmarkRun batched = Measure([&]
+                                       {
+                                           for (size_t batch = 0; batch < batches; ++batch)
+                                           {
+                                               store.OrderPizzas(requests);
+                                           } });
+        BenchmarkRun single = Measure([&]
+                                      {
+                                          for (size_t batch = 0; batch < batches; ++batch)
+                                          {
+                                              for (const OrderRequest &request : requests)
+                                              {
+                                                  delete store.OrderPizza(request.type);
+                                              }
+                                          } });
+        size_t total = batches * batchSize;
+        std::cout << "  size " << batchSize << ": OrderPizzas " << total / batched.seconds << " orders/s, "
+                  << static_cast<double>(batched.allocations) / total << " allocations per order; OrderPizza "
+                  << total / single.seconds << " orders/s, " << static_cast<double>(single.allocations) / total
+                  << " allocations per order\n";
+    }
+}
+
+void BenchmarkSimulator(size_t stores)
+{
+    NYPizzaStore store;
+    SimulationConfig config;
+    config.menu = {{"cheese", 3, 12, 2, 0.5}, {"clam", 4, 15, 2, 0.2}, {"veggie", 5, 10, 2, 0.3}};
+    config.stores = stores;
+    for (KitchenPolicy policy : {KitchenPolicy::Fifo, KitchenPolicy::ShortestBakeFirst, KitchenPolicy::Priority})
+    {
+        config.policy = policy;
+        SimulationReport report;
+        BenchmarkRun run = Measure([&]
+                                   { report = KitchenSimulator(store, config).Run(); });
+        const char *names[] = {"fifo", "shortest bake first", "priority"};
+        std::cout << "simulator: " << names[static_cast<int>(policy)] << ", " << stores << " stores for " << config.days
+                  << " days, " << report.orders << " orders in " << run.seconds << " s, "
+                  << report.orders / run.seconds / 1e6 << "M orders/s, p99 turnaround " << report.turnaround.p99
+                  << " minutes\n";
+    }
+}
+
+int RunBenchmarks(int argc, char **argv)
+{
+    struct Benchmark
+    {
+        const char *name;
+        void (*run)(size_t);
+        size_t defaultScale;
+    };
+    const Benchmark benchmarks[] = {
+        {"orders", BenchmarkOrders, 1000000},
+        {"regions", BenchmarkRegions, 10000000},
+        {"kitchen", BenchmarkKitchen, 200000},
+        {"dispatch", BenchmarkDispatch, 10000000},
+        {"pizza-memory", BenchmarkPizzaMemory, 1000000},
+        {"pooling", BenchmarkPooling, 1000000},
+        {"batches", BenchmarkBatches, 1000000},
+        {"simulator", BenchmarkSimulator, 500},
+    };
+    std::string_view only = argc > 0 ? argv[0] : "";
+    size_t scale = argc > 1 ? std::stoull(argv[1]) : 0;
+    bool ran = false;
+    for (const Benchmark &benchmark : benchmarks)
+    {
+        if (only.empty() || only == benchmark.name)
+        {
+            benchmark.run(scale ? scale : benchmark.defaultScale);
+            ran = true;
+        }
+    }
+    if (!ran)
+    {
+        std::cerr << "Unknown benchmark: " << only << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+// Run with --benchmark [name] [scale] to time the examples instead of
+// printing the demo.
+int main(int argc, char **argv)
+{
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark")
+    {
+        return RunBenchmarks(argc - 2, argv + 2);
+    }
+
+    PizzaStore *nyStore = new NYPizzaStore();
+    PizzaStore *chicagoStore = new ChicagoPizzaStore();
+    PizzaStore *californiaStore = new CaliforniaPizzaStore();
+
+    Pizza *pizza = nyStore->OrderPizza("cheese");
+    std::cout << "Ethan ordered a " << pizza->GetName() << "\n\n";
+    delete pizza;
 
     pizza = chicagoStore->OrderPizza("cheese");
     std::cout << "Joel ordered a " << pizza->GetName() << "\n\n";
@@ -536,6 +2312,66 @@ int main()
     std::cout << "Alex ordered a " << pizza->GetName() << "\n\n";
     delete pizza;
 
+    californiaStore->RegisterPizza("veggie", "California Style Veggie Pizza", PizzaCatalog::Make<VeggiePizza>);
+    pizza = californiaStore->OrderPizza(VEGGIE_PIZZA);
+    std::cout << "Sam ordered a " << pizza->GetName() << "\n\n";
+    delete pizza;
+
+    std::vector<OrderRequest> burst = {{"cheese"}, {"veggie"}, {"cheese"}, {"calzone"}};
+    PizzaBatch batch = nyStore->OrderPizzas(burst);
+    for (size_t i = 0; i < batch.Size(); ++i)
+    {
+        std::cout << "Order " << i + 1 << ": " << (batch[i] ? std::string(batch[i]->GetName()) : "unknown " + burst[i].type) << "\n";
+    }
+    std::cout << "\n";
+
+    for (const char *customer : {"Mia", "Noah"})
+    {
+        PooledPizza pooled = nyStore->OrderPooledPizza("veggie");
+        std::cout << customer << " ordered a " << pooled->GetName() << "\n\n";
+    }
+    PizzaPoolStats poolStats = PizzaPool::GetStats();
+    std::cout << "Pizza pool allocated " << poolStats.allocated << " and reused " << poolStats.reused << "\n\n";
+
+    {
+        PizzaKitchen kitchen(*nyStore);
+        std::vector<std::future<Pizza *>> orders;
+        for (const char *type : {"cheese", "veggie", "clam"})
+        {
+            orders.push_back(kitchen.Submit(type));
+        }
+        for (auto &order : orders)
+        {
+            pizza = order.get();
+            std::cout << "The kitchen finished a " << pizza->GetName() << "\n";
+            delete pizza;
+        }
+        std::cout << "\n";
+    }
+
+    SimulationConfig simulation;
+    simulation.menu = {{"cheese", 3, 12, 2, 0.5}, {"clam", 4, 15, 2, 0.2}, {"veggie", 5, 10, 2, 0.3}};
+    simulation.policy = KitchenPolicy::ShortestBakeFirst;
+    simulation.stores = 5;
+    simulation.days = 7;
+    simulation.ovens = 5;
+    SimulationReport report = KitchenSimulator(*nyStore, simulation).Run();
+    std::cout << "Simulated " << report.completed << " orders across " << simulation.stores << " stores, "
+              << report.ordersPerStoreHour << " completed per open store hour against a capacity of "
+              << report.capacityPerStoreHour << "\n";
+    std::cout << "Orders still in the kitchen at closing: mean " << report.meanBacklogAtClose << ", max "
+              << report.maxBacklogAtClose << "\n";
+    std::cout << "Queue minutes: mean " << report.queueDelay.mean << ", p50 " << report.queueDelay.p50 << ", p90 "
+              << report.queueDelay.p90 << ", p99 " << report.queueDelay.p99 << ", max " << report.queueDelay.max << "\n";
+    std::cout << "Turnaround minutes: mean " << report.turnaround.mean << ", p50 " << report.turnaround.p50 << ", p90 "
+              << report.turnaround.p90 << ", p99 " << report.turnaround.p99 << ", max " << report.turnaround.max << "\n";
+    for (const ResourceUtilization &resource : report.resources)
+    {
+        std::cout << resource.units << " " << resource.name << ": " << resource.openHoursUtilization * 100
+                  << "% busy while open, " << resource.allDayUtilization * 100 << "% around the clock\n";
+    }
+    std::cout << "\n";
+
     delete nyStore;
     delete chicagoStore;
     delete californiaStore;
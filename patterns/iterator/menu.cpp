@@ -3,23 +3,169 @@
 #include <vector>
 #include <memory>
 #include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <queue>
+#include <deque>
+#include <optional>
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <limits>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <new>
+#include <malloc.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
+// Each distinct string is stored once, in blocks that never move, so the
+// views handed out stay valid for the arena's lifetime. Not synchronized:
+// the owning container serializes writers.
+class TextArena
+{
+    static const size_t BLOCK_SIZE = 16384;
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blockUsed = BLOCK_SIZE;
+    std::vector<std::string_view> texts;
+    // Open-addressed table of ids, so interning a new string allocates
+    // nothing beyond arena blocks and the occasional table doubling.
+    static constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> slots;
+    size_t bytes = 0;
+
+    size_t slotFor(std::string_view text) const
+    {
+        size_t mask = slots.size() - 1;
+        for (size_t slot = std::hash<std::string_view>()(text) & mask;; slot = (slot + 1) & mask)
+        {
+            if (slots[slot] == EMPTY_SLOT || texts[slots[slot]] == text)
+            {
+                return slot;
+            }
+        }
+    }
+
+    void grow()
+    {
+        std::vector<uint32_t> old(std::max<size_t>(64, slots.size() * 2), EMPTY_SLOT);
+        old.swap(slots);
+        for (uint32_t id : old)
+        {
+            if (id != EMPTY_SLOT)
+            {
+                slots[slotFor(texts[id])] = id;
+            }
+        }
+    }
+
+    std::string_view store(std::string_view text)
+    {
+        if (text.size() > BLOCK_SIZE / 4)
+        {
+            std::unique_ptr<char[]> block(new char[text.size()]);
+            std::memcpy(block.get(), text.data(), text.size());
+            std::string_view stored(block.get(), text.size());
+            blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, std::move(block));
+            bytes += text.size();
+            return stored;
+        }
+        if (BLOCK_SIZE - blockUsed < text.size())
+        {
+            blocks.emplace_back(new char[BLOCK_SIZE]);
+            bytes += BLOCK_SIZE;
+            blockUsed = 0;
+        }
+        char *at = blocks.back().get() + blockUsed;
+        std::memcpy(at, text.data(), text.size());
+        blockUsed += text.size();
+        return std::string_view(at, text.size());
+    }
+
+public:
+    TextArena() = default;
+    TextArena(const TextArena &) = delete;
+    TextArena &operator=(const TextArena &) = delete;
+
+    uint32_t intern(std::string_view text)
+    {
+        if ((texts.size() + 1) * 2 > slots.size())
+        {
+            grow();
+        }
+        size_t slot = slotFor(text);
+        if (slots[slot] != EMPTY_SLOT)
+        {
+            return slots[slot];
+        }
+        uint32_t id = static_cast<uint32_t>(texts.size());
+        texts.push_back(text.empty() ? std::string_view() : store(text));
+        slots[slot] = id;
+        return id;
+    }
+
+    std::string_view internView(std::string_view text) { return texts[intern(text)]; }
+
+    std::string_view view(uint32_t id) const { return texts[id]; }
+
+    std::optional<std::string_view> find(std::string_view text) const
+    {
+        if (slots.empty())
+        {
+            return std::nullopt;
+        }
+        uint32_t id = slots[slotFor(text)];
+        if (id == EMPTY_SLOT)
+        {
+            return std::nullopt;
+        }
+        return texts[id];
+    }
+
+    size_t size() const { return texts.size(); }
+    size_t capacityBytes() const { return bytes; }
+};
+
+// Name and description view text owned by the menu the item came from.
 class MenuItem
 {
-    std::string name;
-    std::string description;
-    bool vegetarian;
-    double price;
+    std::string_view name;
+    std::string_view description;
+    bool vegetarian = false;
+    double price = 0;
 
 public:
     MenuItem() = default;
-    MenuItem(const std::string &name, const std::string &description, bool vegetarian, double price)
+    MenuItem(std::string_view name, std::string_view description, bool vegetarian, double price)
         : name(name), description(description), vegetarian(vegetarian), price(price) {}
 
-    std::string getName() const { return name; }
-    std::string getDescription() const { return description; }
+    std::string_view getName() const { return name; }
+    std::string_view getDescription() const { return description; }
     bool isVegetarian() const { return vegetarian; }
     double getPrice() const { return price; }
+
+    MenuItem withPrice(double newPrice) const
+    {
+        return MenuItem(name, description, vegetarian, newPrice);
+    }
 };
 
 class Iterator
@@ -31,12 +177,294 @@ public:
     virtual ~Iterator() = default;
 };
 
+class Menu;
+
+// Several menus may offer the same name: the index reports the item as
+// vegetarian if any offer is, and its price as the cheapest offer.
+class MenuItemIndex
+{
+    struct Offer
+    {
+        const Menu *menu;
+        bool vegetarian;
+        double price;
+    };
+
+    struct Summary
+    {
+        bool vegetarian = false;
+        double price = 0;
+    };
+
+    struct Entry : Summary
+    {
+        std::vector<Offer> offers;
+
+        void summarize()
+        {
+            vegetarian = false;
+            price = std::numeric_limits<double>::infinity();
+            for (const Offer &offer : offers)
+            {
+                vegetarian = vegetarian || offer.vegetarian;
+                price = std::min(price, offer.price);
+            }
+        }
+    };
+
+    TextArena names;
+    std::unordered_map<std::string_view, Entry> entry_by_name;
+    std::vector<Menu *> menus;
+    mutable std::shared_mutex mutex;
+
+    std::optional<Summary> findSummary(std::string_view name) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        auto it = entry_by_name.find(name);
+        if (it == entry_by_name.end())
+        {
+            return std::nullopt;
+        }
+        return static_cast<const Summary &>(it->second);
+    }
+
+    friend class Menu;
+
+    void attach(Menu *menu)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        menus.push_back(menu);
+    }
+
+    void forget(const Menu *menu)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        menus.erase(std::remove(menus.begin(), menus.end(), menu), menus.end());
+        for (auto it = entry_by_name.begin(); it != entry_by_name.end();)
+        {
+            std::vector<Offer> &offers = it->second.offers;
+            offers.erase(std::remove_if(offers.begin(), offers.end(), [menu](const Offer &offer)
+                                        { return offer.menu == menu; }),
+                         offers.end());
+            if (offers.empty())
+            {
+                it = entry_by_name.erase(it);
+                continue;
+            }
+            it->second.summarize();
+            ++it;
+        }
+    }
+
+public:
+    MenuItemIndex() = default;
+    ~MenuItemIndex();
+
+    MenuItemIndex(const MenuItemIndex &) = delete;
+    MenuItemIndex &operator=(const MenuItemIndex &) = delete;
+
+    void addItem(const Menu &menu, const MenuItem &item)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = entry_by_name.find(item.getName());
+        if (it == entry_by_name.end())
+        {
+            it = entry_by_name.emplace(names.internView(item.getName()), Entry()).first;
+        }
+        std::vector<Offer> &offers = it->second.offers;
+        auto offer = std::find_if(offers.begin(), offers.end(), [&menu](const Offer &offer)
+                                  { return offer.menu == &menu; });
+        if (offer == offers.end())
+        {
+            offers.push_back(Offer{&menu, item.isVegetarian(), item.getPrice()});
+        }
+        else
+        {
+            offer->vegetarian = offer->vegetarian || item.isVegetarian();
+            offer->price = std::min(offer->price, item.getPrice());
+        }
+        it->second.summarize();
+    }
+
+    void updateItem(const Menu &menu, const MenuItem &item)
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = entry_by_name.find(item.getName());
+        if (it == entry_by_name.end())
+        {
+            return;
+        }
+        for (Offer &offer : it->second.offers)
+        {
+            if (offer.menu == &menu)
+            {
+                offer.price = item.getPrice();
+            }
+        }
+        it->second.summarize();
+    }
+
+    bool contains(const std::string &name) const
+    {
+        return findSummary(name).has_value();
+    }
+
+    bool isVegetarian(const std::string &name) const
+    {
+        std::optional<Summary> summary = findSummary(name);
+        return summary && summary->vegetarian;
+    }
+
+    double getPrice(const std::string &name) const
+    {
+        std::optional<Summary> summary = findSummary(name);
+        if (!summary)
+        {
+            throw std::out_of_range("No menu item named " + name);
+        }
+        return summary->price;
+    }
+
+    size_t size() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        return entry_by_name.size();
+    }
+};
+
+// Iterators hold the published order by shared_ptr, so a later rebuild
+// publishes a new vector instead of reordering one that is being read.
+class PriceIndex
+{
+    std::shared_ptr<const std::vector<size_t>> published = std::make_shared<const std::vector<size_t>>();
+    std::vector<size_t> pending;
+    std::mutex mutex;
+
+public:
+    void add(size_t position)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(position);
+    }
+
+    template <typename PriceOf>
+    std::shared_ptr<const std::vector<size_t>> ordered(PriceOf priceOf)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!pending.empty())
+        {
+            auto byPrice = [&](size_t a, size_t b)
+            { return priceOf(a) < priceOf(b); };
+            std::stable_sort(pending.begin(), pending.end(), byPrice);
+            auto next = std::make_shared<std::vector<size_t>>();
+            next->reserve(published->size() + pending.size());
+            std::merge(published->begin(), published->end(), pending.begin(), pending.end(), std::back_inserter(*next), byPrice);
+            pending.clear();
+            published = std::move(next);
+        }
+        return published;
+    }
+};
+
+class PriceOrderIterator : public Iterator
+{
+    std::shared_ptr<const std::vector<size_t>> order;
+    std::function<MenuItem *(size_t)> itemAt;
+    size_t position;
+
+public:
+    PriceOrderIterator(std::shared_ptr<const std::vector<size_t>> order, std::function<MenuItem *(size_t)> itemAt)
+        : order(std::move(order)), itemAt(std::move(itemAt)), position(0) {}
+
+    bool hasNext() override
+    {
+        return position < order->size();
+    }
+
+    void *next() override
+    {
+        return itemAt((*order)[position++]);
+    }
+};
+
+// A menu keeps every index it feeds and an index keeps every menu feeding
+// it, so whichever is destroyed first unlinks itself from the other.
 class Menu
 {
+    std::vector<MenuItemIndex *> indexes;
+
+    friend class MenuItemIndex;
+
+protected:
+    TextArena arena;
+
+    void indexItem(const MenuItem &item)
+    {
+        for (MenuItemIndex *index : indexes)
+        {
+            index->addItem(*this, item);
+        }
+    }
+
+    void updateIndexedItem(const MenuItem &item)
+    {
+        for (MenuItemIndex *index : indexes)
+        {
+            index->updateItem(*this, item);
+        }
+    }
+
 public:
+    Menu() = default;
+    Menu(const Menu &) = delete;
+    Menu &operator=(const Menu &) = delete;
+
     virtual Iterator *createIterator() = 0;
+    virtual Iterator *createPriceOrderedIterator() = 0;
+    virtual int getNumberOfItems() const = 0;
+
+    virtual ~Menu()
+    {
+        for (MenuItemIndex *index : indexes)
+        {
+            index->forget(this);
+        }
+    }
+
+    void attachIndex(MenuItemIndex *index)
+    {
+        if (std::find(indexes.begin(), indexes.end(), index) != indexes.end())
+        {
+            return;
+        }
+        indexes.push_back(index);
+        index->attach(this);
+        std::unique_ptr<Iterator> iterator(createIterator());
+        while (iterator->hasNext())
+        {
+            index->addItem(*this, *static_cast<MenuItem *>(iterator->next()));
+        }
+    }
+
+    void detachIndex(MenuItemIndex *index)
+    {
+        auto it = std::find(indexes.begin(), indexes.end(), index);
+        if (it != indexes.end())
+        {
+            indexes.erase(it);
+            index->forget(this);
+        }
+    }
 };
 
+MenuItemIndex::~MenuItemIndex()
+{
+    for (Menu *menu : menus)
+    {
+        menu->indexes.erase(std::find(menu->indexes.begin(), menu->indexes.end(), this));
+    }
+}
+
 class PancakeHouseMenuIterator : public Iterator
 {
     MenuItem *items;
@@ -63,6 +491,7 @@ class PancakeHouseMenu : public Menu
     static const int MAX_ITEMS = 6;
     MenuItem menuItems[MAX_ITEMS];
     int numberOfItems;
+    PriceIndex priceIndex;
 
 public:
     PancakeHouseMenu() : numberOfItems(0)
@@ -80,7 +509,9 @@ public:
             std::cout << "Menu is full! Cannot add item to menu." << std::endl;
             return;
         }
-        menuItems[numberOfItems++] = std::move(MenuItem(name, description, vegetarian, price));
+        menuItems[numberOfItems] = MenuItem(arena.internView(name), arena.internView(description), vegetarian, price);
+        priceIndex.add(numberOfItems);
+        indexItem(menuItems[numberOfItems++]);
     }
 
     Iterator *createIterator()
@@ -88,129 +519,1129 @@ public:
         return new PancakeHouseMenuIterator(menuItems, numberOfItems);
     }
 
-    int getNumberOfItems() const { return numberOfItems; }
+    Iterator *createPriceOrderedIterator() override
+    {
+        auto order = priceIndex.ordered([this](size_t position)
+                                        { return menuItems[position].getPrice(); });
+        return new PriceOrderIterator(order, [this](size_t position)
+                                      { return &menuItems[position]; });
+    }
+
+    int getNumberOfItems() const override { return numberOfItems; }
 };
 
-class DinerMenuIterator : public Iterator
+class EpochManager
 {
-    std::vector<MenuItem> &items;
-    size_t position;
+    static const size_t MAX_READERS = 64;
+    static const uint64_t IDLE = UINT64_MAX;
+
+    std::atomic<uint64_t> globalEpoch{0};
+    std::atomic<uint64_t> pinned[MAX_READERS];
+    std::atomic<uint64_t> overflowOldest{IDLE};
+    std::map<uint64_t, size_t> overflowReaders;
+    std::mutex overflowMutex;
 
 public:
-    DinerMenuIterator(std::vector<MenuItem> &items) : items(items), position(0) {}
+    struct Slot
+    {
+        size_t index;
+        uint64_t epoch;
+    };
 
-    bool hasNext() override
+    EpochManager()
     {
-        return position < items.size();
+        for (auto &slot : pinned)
+        {
+            slot.store(IDLE);
+        }
     }
 
-    void *next() override
+    Slot enter()
     {
-        return const_cast<MenuItem *>(&items[position++]);
+        uint64_t epoch = globalEpoch.load();
+        for (size_t slot = 0; slot < MAX_READERS; ++slot)
+        {
+            uint64_t idle = IDLE;
+            if (pinned[slot].compare_exchange_strong(idle, epoch))
+            {
+                return {slot, epoch};
+            }
+        }
+        std::lock_guard<std::mutex> lock(overflowMutex);
+        epoch = globalEpoch.load();
+        ++overflowReaders[epoch];
+        overflowOldest.store(overflowReaders.begin()->first);
+        return {MAX_READERS, epoch};
     }
-};
-
-class DinerMenu : public Menu
-{
-    std::vector<MenuItem> menuItems;
 
-public:
-    DinerMenu()
+    void exit(const Slot &slot)
     {
-        addItem("Vegetarian BLT", "Fakin' Bacon with lettuce & tomato on whole wheat", true, 2.99);
-        addItem("BLT", "Bacon with lettuce & tomato on whole wheat", false, 2.99);
-        addItem("Soup of the day", "Soup of the day, with a side of potato salad", false, 3.29);
-        addItem("Hotdog", "A hot dog, with sauerkraut, relish, onions, topped with cheese", false, 3.05);
+        if (slot.index < MAX_READERS)
+        {
+            pinned[slot.index].store(IDLE);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(overflowMutex);
+        auto it = overflowReaders.find(slot.epoch);
+        if (--it->second == 0)
+        {
+            overflowReaders.erase(it);
+        }
+        overflowOldest.store(overflowReaders.empty() ? IDLE : overflowReaders.begin()->first);
     }
 
-    void addItem(const std::string &name, const std::string &description, bool vegetarian, double price)
+    uint64_t advance()
     {
-        menuItems.emplace_back(name, description, vegetarian, price);
+        return globalEpoch.fetch_add(1);
     }
 
-    Iterator *createIterator()
+    uint64_t oldestPinned() const
     {
-        return new DinerMenuIterator(menuItems);
+        uint64_t oldest = overflowOldest.load();
+        for (const auto &slot : pinned)
+        {
+            oldest = std::min(oldest, slot.load());
+        }
+        return oldest;
     }
-
-    int getNumberOfItems() const { return static_cast<int>(menuItems.size()); }
 };
 
-class CafeMenuIterator : public Iterator
+template <typename Version>
+class Versioned
 {
-    std::unordered_map<std::string, MenuItem> itemsMap;
-    std::unordered_map<std::string, MenuItem>::iterator position;
+    struct Retired
+    {
+        std::unique_ptr<const Version> version;
+        uint64_t epoch;
+    };
 
-public:
-    CafeMenuIterator(const std::unordered_map<std::string, MenuItem> &menuMap) : itemsMap(menuMap)
+    mutable EpochManager epochs;
+    std::atomic<const Version *> current;
+    mutable std::vector<Retired> retired;
+    mutable std::atomic<size_t> retiredCount{0};
+    mutable std::mutex writerMutex;
+
+    void reclaim() const
     {
-        position = itemsMap.begin();
+        uint64_t oldest = epochs.oldestPinned();
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [oldest](const Retired &entry)
+                                     { return entry.epoch < oldest; }),
+                      retired.end());
+        retiredCount.store(retired.size());
     }
 
-    bool hasNext() override
+    // A reader leaving may be the last one holding an old version alive, so
+    // it frees what it can unless a writer already holds the lock.
+    void reclaimAfterReader() const
     {
-        return position != itemsMap.end();
+        if (retiredCount.load(std::memory_order_relaxed) == 0)
+            return;
+        std::unique_lock<std::mutex> lock(writerMutex, std::try_to_lock);
+        if (lock)
+        {
+            reclaim();
+        }
     }
 
-    void *next() override
+    void publish(std::unique_ptr<Version> next)
     {
-        return &((position++)->second);
+        const Version *previous = current.load();
+        current.store(next.release());
+        retired.push_back({std::unique_ptr<const Version>(previous), epochs.advance()});
+        reclaim();
     }
-};
-
-class CafeMenu : public Menu
-{
-    std::unordered_map<std::string, MenuItem> menuItems;
 
 public:
-    CafeMenu()
+    class Pin
     {
-        addItem("Cappuccino", "Espresso with steamed milk foam", true, 3.50);
-        addItem("Espresso", "Strong black coffee", true,
-                2.75);
-        addItem("Turkey Sandwich", "Turkey sandwich with lettuce and tomato", false, 5.25);
+        const Versioned &owner;
+        EpochManager::Slot slot;
+        const Version *version;
+
+    public:
+        Pin(const Versioned &owner) : owner(owner), slot(owner.epochs.enter()), version(owner.current.load()) {}
+        ~Pin()
+        {
+            owner.epochs.exit(slot);
+            owner.reclaimAfterReader();
+        }
+
+        Pin(const Pin &) = delete;
+        Pin &operator=(const Pin &) = delete;
+
+        const Version &get() const { return *version; }
+    };
+
+    Versioned() : current(new Version()) {}
+
+    ~Versioned()
+    {
+        delete current.load();
     }
 
-    void addItem(const std::string &name, const std::string &description, bool vegetarian, double price)
+    Versioned(const Versioned &) = delete;
+    Versioned &operator=(const Versioned &) = delete;
+
+    template <typename Mutate>
+    void update(Mutate mutate)
     {
-        menuItems.emplace(name, MenuItem(name, description, vegetarian, price));
+        std::lock_guard<std::mutex> lock(writerMutex);
+        auto next = std::make_unique<Version>(*current.load());
+        mutate(*next);
+        publish(std::move(next));
     }
 
-    Iterator *createIterator() override
+    // Runs locate against the current version first and copies it only when
+    // locate finds something for mutate to change.
+    template <typename Locate, typename Mutate>
+    bool updateWhere(Locate locate, Mutate mutate)
     {
-        return new CafeMenuIterator(menuItems);
+        std::lock_guard<std::mutex> lock(writerMutex);
+        auto found = locate(*current.load());
+        if (!found)
+            return false;
+        auto next = std::make_unique<Version>(*current.load());
+        mutate(*next, *found);
+        publish(std::move(next));
+        return true;
     }
+
 };
 
-class Waitress
+struct DinerMenuVersion
 {
-    std::unordered_map<std::string, Menu *> menu_by_name;
+    std::vector<MenuItem> items;
+    std::vector<size_t> priceOrder;
 
-    void printMenu(Iterator &iterator)
+    void insertByPrice(size_t position)
     {
-        while (iterator.hasNext())
-        {
-            MenuItem *item = static_cast<MenuItem *>(iterator.next());
-            std::cout << item->getName() << ", " << item->getPrice() << " -- " << item->getDescription() << std::endl;
-        }
+        double price = items[position].getPrice();
+        auto at = std::upper_bound(priceOrder.begin(), priceOrder.end(), price, [this](double value, size_t other)
+                                   { return value < items[other].getPrice(); });
+        priceOrder.insert(at, position);
     }
 
-    bool isVegetarian(Iterator &iterator, const std::string &itemName)
+    void mergeByPrice(size_t first)
     {
-        while (iterator.hasNext())
+        auto cheaper = [this](size_t a, size_t b)
+        { return items[a].getPrice() < items[b].getPrice(); };
+        size_t middle = priceOrder.size();
+        for (size_t position = first; position < items.size(); ++position)
         {
-            MenuItem *item = static_cast<MenuItem *>(iterator.next());
-            if (item->getName() == itemName)
+            priceOrder.push_back(position);
+        }
+        std::stable_sort(priceOrder.begin() + middle, priceOrder.end(), cheaper);
+        std::inplace_merge(priceOrder.begin(), priceOrder.begin() + middle, priceOrder.end(), cheaper);
+    }
+};
+
+class DinerMenuIterator : public Iterator
+{
+    Versioned<DinerMenuVersion>::Pin snapshot;
+    bool byPrice;
+    size_t position;
+
+public:
+    DinerMenuIterator(const Versioned<DinerMenuVersion> &versions, bool byPrice = false)
+        : snapshot(versions), byPrice(byPrice), position(0) {}
+
+    bool hasNext() override
+    {
+        return position < snapshot.get().items.size();
+    }
+
+    void *next() override
+    {
+        const DinerMenuVersion &version = snapshot.get();
+        size_t row = position++;
+        return const_cast<MenuItem *>(&version.items[byPrice ? version.priceOrder[row] : row]);
+    }
+};
+
+class DinerMenu : public Menu
+{
+    Versioned<DinerMenuVersion> versions;
+
+public:
+    DinerMenu()
+    {
+        addItems({MenuItem("Vegetarian BLT", "Fakin' Bacon with lettuce & tomato on whole wheat", true, 2.99),
+                  MenuItem("BLT", "Bacon with lettuce & tomato on whole wheat", false, 2.99),
+                  MenuItem("Soup of the day", "Soup of the day, with a side of potato salad", false, 3.29),
+                  MenuItem("Hotdog", "A hot dog, with sauerkraut, relish, onions, topped with cheese", false, 3.05)});
+    }
+
+    void addItem(const std::string &name, const std::string &description, bool vegetarian, double price)
+    {
+        versions.update([&](DinerMenuVersion &version)
+                        {
+                            version.items.emplace_back(arena.internView(name), arena.internView(description), vegetarian, price);
+                            version.insertByPrice(version.items.size() - 1);
+                            indexItem(version.items.back()); });
+    }
+
+    void addItems(const std::vector<MenuItem> &items)
+    {
+        versions.update([&](DinerMenuVersion &version)
+                        {
+                            size_t first = version.items.size();
+                            for (const MenuItem &item : items)
+                            {
+                                version.items.emplace_back(arena.internView(item.getName()), arena.internView(item.getDescription()),
+                                                           item.isVegetarian(), item.getPrice());
+                            }
+                            version.mergeByPrice(first);
+                            for (size_t position = first; position < version.items.size(); ++position)
+                            {
+                                indexItem(version.items[position]);
+                            } });
+    }
+
+    bool updatePrice(const std::string &name, double price)
+    {
+        auto locate = [&](const DinerMenuVersion &version) -> std::optional<size_t>
+        {
+            std::optional<std::string_view> interned = arena.find(name);
+            for (size_t position = 0; interned && position < version.items.size(); ++position)
+            {
+                if (version.items[position].getName().data() == interned->data())
+                    return position;
+            }
+            return std::nullopt;
+        };
+        return versions.updateWhere(locate, [&](DinerMenuVersion &version, size_t position)
+                                    {
+                                        MenuItem &item = version.items[position];
+                                        item = item.withPrice(price);
+                                        version.priceOrder.erase(std::find(version.priceOrder.begin(), version.priceOrder.end(), position));
+                                        version.insertByPrice(position);
+                                        updateIndexedItem(item); });
+    }
+
+    Iterator *createIterator()
+    {
+        return new DinerMenuIterator(versions);
+    }
+
+    Iterator *createPriceOrderedIterator() override
+    {
+        return new DinerMenuIterator(versions, true);
+    }
+
+    int getNumberOfItems() const override
+    {
+        Versioned<DinerMenuVersion>::Pin snapshot(versions);
+        return static_cast<int>(snapshot.get().items.size());
+    }
+};
+
+class CafeMenuIterator : public Iterator
+{
+    std::unordered_map<std::string, MenuItem> itemsMap;
+    std::unordered_map<std::string, MenuItem>::iterator position;
+
+public:
+    CafeMenuIterator(const std::unordered_map<std::string, MenuItem> &menuMap) : itemsMap(menuMap)
+    {
+        position = itemsMap.begin();
+    }
+
+    bool hasNext() override
+    {
+        return position != itemsMap.end();
+    }
+
+    void *next() override
+    {
+        return &((position++)->second);
+    }
+};
+
+class CafeMenu : public Menu
+{
+    std::unordered_map<std::string, MenuItem> menuItems;
+    std::vector<MenuItem *> itemByPosition;
+    PriceIndex priceIndex;
+
+public:
+    CafeMenu()
+    {
+        addItem("Cappuccino", "Espresso with steamed milk foam", true, 3.50);
+        addItem("Espresso", "Strong black coffee", true,
+                2.75);
+        addItem("Turkey Sandwich", "Turkey sandwich with lettuce and tomato", false, 5.25);
+    }
+
+    void addItem(const std::string &name, const std::string &description, bool vegetarian, double price)
+    {
+        auto [it, inserted] = menuItems.try_emplace(name);
+        if (inserted)
+        {
+            it->second = MenuItem(arena.internView(name), arena.internView(description), vegetarian, price);
+            priceIndex.add(itemByPosition.size());
+            itemByPosition.push_back(&it->second);
+            indexItem(it->second);
+        }
+    }
+
+    Iterator *createIterator() override
+    {
+        return new CafeMenuIterator(menuItems);
+    }
+
+    Iterator *createPriceOrderedIterator() override
+    {
+        auto order = priceIndex.ordered([this](size_t position)
+                                        { return itemByPosition[position]->getPrice(); });
+        return new PriceOrderIterator(order, [this](size_t position)
+                                      { return itemByPosition[position]; });
+    }
+
+    int getNumberOfItems() const override { return static_cast<int>(menuItems.size()); }
+};
+
+class ColumnarMenu;
+
+// Adapts the columns to the MenuItem-based Iterator protocol; scans that only
+// need a few columns should use ColumnarMenu::rows() instead.
+class ColumnarMenuIterator : public Iterator
+{
+    const ColumnarMenu &menu;
+    std::shared_ptr<const std::vector<size_t>> order;
+    size_t position;
+    MenuItem current;
+
+public:
+    ColumnarMenuIterator(const ColumnarMenu &menu, std::shared_ptr<const std::vector<size_t>> order = nullptr)
+        : menu(menu), order(std::move(order)), position(0) {}
+
+    bool hasNext() override;
+    void *next() override;
+};
+
+class ColumnarMenu : public Menu
+{
+    std::vector<uint32_t> names;
+    std::vector<uint32_t> descriptions;
+    std::vector<double> prices;
+    std::vector<uint64_t> vegetarianBits;
+    PriceIndex priceIndex;
+
+    uint64_t priceBelowMask(size_t word, double maxPrice) const
+    {
+        size_t begin = word * 64;
+        const double *block = prices.data() + begin;
+        double padded[64];
+        if (prices.size() - begin < 64)
+        {
+            std::fill(std::copy(block, prices.data() + prices.size(), padded), padded + 64,
+                      std::numeric_limits<double>::quiet_NaN());
+            block = padded;
+        }
+        uint64_t mask = 0;
+#if defined(__AVX__)
+        __m256d limit = _mm256_set1_pd(maxPrice);
+        for (size_t i = 0; i < 64; i += 4)
+        {
+            __m256d below = _mm256_cmp_pd(_mm256_loadu_pd(block + i), limit, _CMP_LT_OQ);
+            mask |= static_cast<uint64_t>(_mm256_movemask_pd(below)) << i;
+        }
+#elif defined(__SSE2__)
+        __m128d limit = _mm_set1_pd(maxPrice);
+        for (size_t i = 0; i < 64; i += 2)
+        {
+            __m128d below = _mm_cmplt_pd(_mm_loadu_pd(block + i), limit);
+            mask |= static_cast<uint64_t>(_mm_movemask_pd(below)) << i;
+        }
+#else
+        for (size_t i = 0; i < 64; ++i)
+        {
+            mask |= static_cast<uint64_t>(block[i] < maxPrice) << i;
+        }
+#endif
+        return mask;
+    }
+
+    static void appendSelected(uint64_t mask, size_t word, std::vector<size_t> &selection)
+    {
+        while (mask)
+        {
+            selection.push_back(word * 64 + __builtin_ctzll(mask));
+            mask &= mask - 1;
+        }
+    }
+
+public:
+    void addItem(const std::string &name, const std::string &description, bool vegetarian, double price)
+    {
+        size_t row = prices.size();
+        names.push_back(arena.intern(name));
+        descriptions.push_back(arena.intern(description));
+        prices.push_back(price);
+        if (row % 64 == 0)
+        {
+            vegetarianBits.push_back(0);
+        }
+        vegetarianBits.back() |= static_cast<uint64_t>(vegetarian) << (row % 64);
+        priceIndex.add(row);
+        indexItem(getItem(row));
+    }
+
+    class Row
+    {
+        const ColumnarMenu *menu;
+        size_t row;
+
+    public:
+        Row(const ColumnarMenu &menu, size_t row) : menu(&menu), row(row) {}
+
+        size_t index() const { return row; }
+        std::string_view getName() const { return menu->getName(row); }
+        std::string_view getDescription() const { return menu->getDescription(row); }
+        bool isVegetarian() const { return menu->isVegetarian(row); }
+        double getPrice() const { return menu->getPrice(row); }
+    };
+
+    class RowIterator
+    {
+        const ColumnarMenu *menu;
+        const size_t *selection;
+        size_t position;
+
+    public:
+        RowIterator(const ColumnarMenu &menu, const size_t *selection, size_t position)
+            : menu(&menu), selection(selection), position(position) {}
+
+        Row operator*() const { return Row(*menu, selection ? selection[position] : position); }
+        RowIterator &operator++()
+        {
+            ++position;
+            return *this;
+        }
+        bool operator!=(const RowIterator &other) const { return position != other.position; }
+    };
+
+    struct Rows
+    {
+        RowIterator first;
+        RowIterator last;
+
+        RowIterator begin() const { return first; }
+        RowIterator end() const { return last; }
+    };
+
+    Rows rows() const
+    {
+        return {RowIterator(*this, nullptr, 0), RowIterator(*this, nullptr, size())};
+    }
+
+    Rows rows(const std::vector<size_t> &selection) const
+    {
+        return {RowIterator(*this, selection.data(), 0), RowIterator(*this, selection.data(), selection.size())};
+    }
+
+    size_t size() const { return prices.size(); }
+    int getNumberOfItems() const override { return static_cast<int>(prices.size()); }
+    std::string_view getName(size_t row) const { return arena.view(names[row]); }
+    std::string_view getDescription(size_t row) const { return arena.view(descriptions[row]); }
+    bool isVegetarian(size_t row) const { return (vegetarianBits[row / 64] >> (row % 64)) & 1; }
+    double getPrice(size_t row) const { return prices[row]; }
+
+    MenuItem getItem(size_t row) const
+    {
+        return MenuItem(getName(row), getDescription(row), isVegetarian(row), getPrice(row));
+    }
+
+    std::vector<size_t> selectVegetarian() const
+    {
+        std::vector<size_t> selection;
+        for (size_t word = 0; word < vegetarianBits.size(); ++word)
+        {
+            appendSelected(vegetarianBits[word], word, selection);
+        }
+        return selection;
+    }
+
+    std::vector<size_t> selectPriceBelow(double maxPrice) const
+    {
+        std::vector<size_t> selection;
+        for (size_t word = 0; word < vegetarianBits.size(); ++word)
+        {
+            appendSelected(priceBelowMask(word, maxPrice), word, selection);
+        }
+        return selection;
+    }
+
+    std::vector<size_t> selectVegetarianPriceBelow(double maxPrice) const
+    {
+        std::vector<size_t> selection;
+        for (size_t word = 0; word < vegetarianBits.size(); ++word)
+        {
+            if (vegetarianBits[word])
+            {
+                appendSelected(vegetarianBits[word] & priceBelowMask(word, maxPrice), word, selection);
+            }
+        }
+        return selection;
+    }
+
+    Iterator *createIterator() override
+    {
+        return new ColumnarMenuIterator(*this);
+    }
+
+    Iterator *createPriceOrderedIterator() override
+    {
+        return new ColumnarMenuIterator(*this, priceIndex.ordered([this](size_t row)
+                                                                  { return prices[row]; }));
+    }
+};
+
+bool ColumnarMenuIterator::hasNext()
+{
+    return position < (order ? order->size() : menu.size());
+}
+
+void *ColumnarMenuIterator::next()
+{
+    size_t row = position++;
+    current = menu.getItem(order ? (*order)[row] : row);
+    return &current;
+}
+
+// Catalogs are written in the writer's native byte order; byteOrder lets a
+// reader on another architecture reject the file instead of misreading it.
+struct CatalogHeader
+{
+    char magic[8];
+    uint32_t byteOrder;
+    uint32_t version;
+    uint32_t itemCount;
+    uint32_t stringCount;
+    uint64_t itemsOffset;
+    uint64_t priceOrderOffset;
+    uint64_t stringsOffset;
+    uint64_t textOffset;
+    uint64_t textSize;
+};
+
+struct CatalogString
+{
+    uint64_t offset;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct CatalogItem
+{
+    double price;
+    uint32_t name;
+    uint32_t description;
+    uint8_t vegetarian;
+    uint8_t reserved[7];
+};
+
+static const char CATALOG_MAGIC[8] = {'M', 'E', 'N', 'U', 'C', 'A', 'T', '\0'};
+static const uint32_t CATALOG_BYTE_ORDER = 0x01020304;
+static const uint32_t CATALOG_VERSION = 2;
+
+class CatalogBuilder
+{
+    std::vector<CatalogItem> items;
+    std::vector<CatalogString> strings;
+    std::string text;
+    std::unordered_map<std::string, uint32_t> string_ids;
+
+    uint32_t addString(std::string_view value)
+    {
+        auto [it, inserted] = string_ids.try_emplace(std::string(value), static_cast<uint32_t>(strings.size()));
+        if (inserted)
+        {
+            strings.push_back({text.size(), static_cast<uint32_t>(value.size()), 0});
+            text += value;
+        }
+        return it->second;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 7) & ~uint64_t(7);
+    }
+
+public:
+    void addItem(std::string_view name, std::string_view description, bool vegetarian, double price)
+    {
+        CatalogItem item{};
+        item.price = price;
+        item.name = addString(name);
+        item.description = addString(description);
+        item.vegetarian = vegetarian;
+        items.push_back(item);
+    }
+
+    void addMenu(Menu &menu)
+    {
+        std::unique_ptr<Iterator> iterator(menu.createIterator());
+        while (iterator->hasNext())
+        {
+            MenuItem *item = static_cast<MenuItem *>(iterator->next());
+            addItem(item->getName(), item->getDescription(), item->isVegetarian(), item->getPrice());
+        }
+    }
+
+    void write(const std::string &path) const
+    {
+        std::vector<uint32_t> priceOrder(items.size());
+        for (uint32_t i = 0; i < priceOrder.size(); ++i)
+        {
+            priceOrder[i] = i;
+        }
+        std::stable_sort(priceOrder.begin(), priceOrder.end(), [this](uint32_t a, uint32_t b)
+                         { return items[a].price < items[b].price; });
+
+        CatalogHeader header{};
+        std::memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+        header.byteOrder = CATALOG_BYTE_ORDER;
+        header.version = CATALOG_VERSION;
+        header.itemCount = static_cast<uint32_t>(items.size());
+        header.stringCount = static_cast<uint32_t>(strings.size());
+        header.itemsOffset = align(sizeof(CatalogHeader));
+        header.priceOrderOffset = align(header.itemsOffset + items.size() * sizeof(CatalogItem));
+        header.stringsOffset = align(header.priceOrderOffset + priceOrder.size() * sizeof(uint32_t));
+        header.textOffset = header.stringsOffset + strings.size() * sizeof(CatalogString);
+        header.textSize = text.size();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("Cannot open menu catalog for writing: " + path);
+        }
+        auto writeAt = [&out](uint64_t offset, const void *data, size_t size)
+        {
+            static const char padding[8] = {};
+            out.write(padding, offset - static_cast<uint64_t>(out.tellp()));
+            out.write(static_cast<const char *>(data), size);
+        };
+        writeAt(0, &header, sizeof(header));
+        writeAt(header.itemsOffset, items.data(), items.size() * sizeof(CatalogItem));
+        writeAt(header.priceOrderOffset, priceOrder.data(), priceOrder.size() * sizeof(uint32_t));
+        writeAt(header.stringsOffset, strings.data(), strings.size() * sizeof(CatalogString));
+        writeAt(header.textOffset, text.data(), text.size());
+        if (!out)
+        {
+            throw std::runtime_error("Failed to write menu catalog: " + path);
+        }
+    }
+};
+
+class MappedCatalogMenu;
+
+class MappedCatalogMenuIterator : public Iterator
+{
+    const MappedCatalogMenu &menu;
+    const uint32_t *order;
+    size_t position;
+    MenuItem current;
+
+public:
+    MappedCatalogMenuIterator(const MappedCatalogMenu &menu, const uint32_t *order = nullptr)
+        : menu(menu), order(order), position(0) {}
+
+    bool hasNext() override;
+    void *next() override;
+};
+
+class MappedCatalogMenu : public Menu
+{
+    const char *data = nullptr;
+    size_t fileSize = 0;
+    const CatalogHeader *header = nullptr;
+    const CatalogItem *items = nullptr;
+    const uint32_t *priceOrder = nullptr;
+    const CatalogString *strings = nullptr;
+
+    bool sectionFits(uint64_t offset, uint64_t size) const
+    {
+        return offset % 8 == 0 && offset <= fileSize && size <= fileSize - offset;
+    }
+
+    void validate(const std::string &path) const
+    {
+        if (fileSize < sizeof(CatalogHeader) ||
+            std::memcmp(header->magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0)
+        {
+            throw std::runtime_error("Not a menu catalog: " + path);
+        }
+        if (header->byteOrder != CATALOG_BYTE_ORDER)
+        {
+            throw std::runtime_error("Menu catalog was written with a different byte order: " + path);
+        }
+        if (header->version != CATALOG_VERSION)
+        {
+            throw std::runtime_error("Unsupported menu catalog version " + std::to_string(header->version) + ": " + path);
+        }
+        if (!sectionFits(header->itemsOffset, uint64_t(header->itemCount) * sizeof(CatalogItem)) ||
+            !sectionFits(header->priceOrderOffset, uint64_t(header->itemCount) * sizeof(uint32_t)) ||
+            !sectionFits(header->stringsOffset, uint64_t(header->stringCount) * sizeof(CatalogString)) ||
+            header->textOffset > fileSize || header->textSize > fileSize - header->textOffset)
+        {
+            throw std::runtime_error("Truncated menu catalog: " + path);
+        }
+    }
+
+    const CatalogItem &item(size_t row) const
+    {
+        if (row >= header->itemCount)
+        {
+            throw std::out_of_range("Catalog row out of range");
+        }
+        return items[row];
+    }
+
+    std::string_view text(uint32_t string) const
+    {
+        if (string >= header->stringCount)
+        {
+            throw std::runtime_error("Corrupt menu catalog string reference");
+        }
+        const CatalogString &ref = strings[string];
+        if (ref.offset > header->textSize || ref.length > header->textSize - ref.offset)
+        {
+            throw std::runtime_error("Corrupt menu catalog string range");
+        }
+        return std::string_view(data + header->textOffset + ref.offset, ref.length);
+    }
+
+public:
+    MappedCatalogMenu(const std::string &path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot open menu catalog: " + path);
+        }
+        struct stat status;
+        if (fstat(fd, &status) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot stat menu catalog: " + path);
+        }
+        fileSize = static_cast<size_t>(status.st_size);
+        void *mapping = fileSize ? mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            throw std::runtime_error("Cannot map menu catalog: " + path);
+        }
+        data = static_cast<const char *>(mapping);
+        header = reinterpret_cast<const CatalogHeader *>(data);
+        try
+        {
+            validate(path);
+        }
+        catch (...)
+        {
+            munmap(mapping, fileSize);
+            throw;
+        }
+        items = reinterpret_cast<const CatalogItem *>(data + header->itemsOffset);
+        priceOrder = reinterpret_cast<const uint32_t *>(data + header->priceOrderOffset);
+        strings = reinterpret_cast<const CatalogString *>(data + header->stringsOffset);
+    }
+
+    ~MappedCatalogMenu()
+    {
+        munmap(const_cast<char *>(data), fileSize);
+    }
+
+    MappedCatalogMenu(const MappedCatalogMenu &) = delete;
+    MappedCatalogMenu &operator=(const MappedCatalogMenu &) = delete;
+
+    size_t size() const { return header->itemCount; }
+    int getNumberOfItems() const override { return static_cast<int>(header->itemCount); }
+    std::string_view getName(size_t row) const { return text(item(row).name); }
+    std::string_view getDescription(size_t row) const { return text(item(row).description); }
+    bool isVegetarian(size_t row) const { return item(row).vegetarian != 0; }
+    double getPrice(size_t row) const { return item(row).price; }
+
+    MenuItem getItem(size_t row) const
+    {
+        const CatalogItem &record = item(row);
+        return MenuItem(text(record.name), text(record.description), record.vegetarian != 0, record.price);
+    }
+
+    size_t getPriceOrderedRow(size_t position) const
+    {
+        uint32_t row = priceOrder[position];
+        if (row >= header->itemCount)
+        {
+            throw std::runtime_error("Corrupt menu catalog price order");
+        }
+        return row;
+    }
+
+    Iterator *createIterator() override
+    {
+        return new MappedCatalogMenuIterator(*this);
+    }
+
+    Iterator *createPriceOrderedIterator() override
+    {
+        return new MappedCatalogMenuIterator(*this, priceOrder);
+    }
+};
+
+bool MappedCatalogMenuIterator::hasNext()
+{
+    return position < menu.size();
+}
+
+void *MappedCatalogMenuIterator::next()
+{
+    size_t row = position++;
+    current = menu.getItem(order ? menu.getPriceOrderedRow(row) : row);
+    return &current;
+}
+
+class PriceMergeIterator : public Iterator
+{
+    struct Head
+    {
+        double price;
+        size_t source;
+        MenuItem *item;
+
+        bool operator>(const Head &other) const
+        {
+            return price != other.price ? price > other.price : source > other.source;
+        }
+    };
+
+    std::vector<std::unique_ptr<Iterator>> sources;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    size_t pendingSource;
+
+    void pull(size_t source)
+    {
+        if (sources[source]->hasNext())
+        {
+            MenuItem *item = static_cast<MenuItem *>(sources[source]->next());
+            heads.push({item->getPrice(), source, item});
+        }
+    }
+
+    void refill()
+    {
+        if (pendingSource < sources.size())
+        {
+            pull(pendingSource);
+            pendingSource = sources.size();
+        }
+    }
+
+public:
+    PriceMergeIterator(std::vector<std::unique_ptr<Iterator>> priceOrderedSources)
+        : sources(std::move(priceOrderedSources)), pendingSource(sources.size())
+    {
+        for (size_t source = 0; source < sources.size(); ++source)
+        {
+            pull(source);
+        }
+    }
+
+    bool hasNext() override
+    {
+        refill();
+        return !heads.empty();
+    }
+
+    void *next() override
+    {
+        if (!hasNext())
+            return nullptr;
+        Head head = heads.top();
+        heads.pop();
+        pendingSource = head.source;
+        return head.item;
+    }
+};
+
+class ThreadPool
+{
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this]
+                               { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+public:
+    explicit ThreadPool(size_t threads)
+    {
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers.emplace_back(&ThreadPool::work, this);
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    template <typename Task>
+    auto submit(Task task) -> std::future<decltype(task())>
+    {
+        auto packaged = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+        auto result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packaged]
+                          { (*packaged)(); });
+        }
+        available.notify_one();
+        return result;
+    }
+
+    size_t size() const { return workers.size(); }
+};
+
+class Waitress
+{
+    std::unordered_map<std::string, Menu *> menu_by_name;
+    MenuItemIndex item_index;
+    ThreadPool pool;
+
+    static const size_t PARALLEL_ITEM_THRESHOLD = 16384;
+
+    template <typename Visit>
+    static void forEachItem(Menu &menu, Visit &visit)
+    {
+        std::unique_ptr<Iterator> iterator(menu.createIterator());
+        while (iterator->hasNext())
+        {
+            visit(*static_cast<MenuItem *>(iterator->next()));
+        }
+    }
+
+    template <typename Partial, typename Scan, typename Merge>
+    Partial queryMenus(Scan scan, Merge merge)
+    {
+        std::vector<Menu *> menus;
+        size_t totalItems = 0;
+        for (const auto &[name, menu] : menu_by_name)
+        {
+            menus.push_back(menu);
+            totalItems += menu->getNumberOfItems();
+        }
+
+        size_t partitions = std::min(pool.size(), menus.size());
+        if (totalItems < PARALLEL_ITEM_THRESHOLD || partitions < 2)
+        {
+            Partial result{};
+            for (Menu *menu : menus)
             {
-                return item->isVegetarian();
+                scan(*menu, result);
             }
+            return result;
+        }
+
+        std::vector<std::future<Partial>> partials;
+        for (size_t i = 0; i < partitions; ++i)
+        {
+            size_t begin = i * menus.size() / partitions;
+            size_t end = (i + 1) * menus.size() / partitions;
+            partials.push_back(pool.submit([&menus, &scan, begin, end]
+                                           {
+                                               Partial partial{};
+                                               for (size_t m = begin; m < end; ++m)
+                                               {
+                                                   scan(*menus[m], partial);
+                                               }
+                                               return partial; }));
+        }
+
+        for (std::future<Partial> &partial : partials)
+        {
+            partial.wait();
+        }
+        Partial result = partials.front().get();
+        for (size_t i = 1; i < partials.size(); ++i)
+        {
+            merge(result, partials[i].get());
+        }
+        return result;
+    }
+
+    static bool cheaper(const MenuItem &a, const MenuItem &b)
+    {
+        return a.getPrice() < b.getPrice();
+    }
+
+    static void keepCheapest(std::vector<MenuItem> &heap, const MenuItem &item, size_t k)
+    {
+        if (heap.size() < k)
+        {
+            heap.push_back(item);
+            std::push_heap(heap.begin(), heap.end(), cheaper);
+        }
+        else if (k > 0 && cheaper(item, heap.front()))
+        {
+            std::pop_heap(heap.begin(), heap.end(), cheaper);
+            heap.back() = item;
+            std::push_heap(heap.begin(), heap.end(), cheaper);
+        }
+    }
+
+    void printMenu(Iterator &iterator)
+    {
+        while (iterator.hasNext())
+        {
+            MenuItem *item = static_cast<MenuItem *>(iterator.next());
+            std::cout << item->getName() << ", " << item->getPrice() << " -- " << item->getDescription() << std::endl;
         }
-        return false;
     }
 
 public:
-    Waitress(std::unordered_map<std::string, Menu *> menus)
-        : menu_by_name(std::move(menus)) {}
+    Waitress(std::unordered_map<std::string, Menu *> menus,
+             size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+        : menu_by_name(std::move(menus)), pool(threads)
+    {
+        for (const auto &[name, menu] : menu_by_name)
+        {
+            menu->attachIndex(&item_index);
+        }
+    }
 
     void printMenu()
     {
@@ -223,6 +1654,27 @@ public:
         }
     }
 
+    Iterator *createPriceOrderedIterator()
+    {
+        std::vector<std::unique_ptr<Iterator>> sources;
+        for (const auto &[name, menu] : menu_by_name)
+        {
+            sources.emplace_back(menu->createPriceOrderedIterator());
+        }
+        return new PriceMergeIterator(std::move(sources));
+    }
+
+    void printMenuByPrice(size_t pageSize)
+    {
+        std::cout << "Menu by Price:" << std::endl;
+        std::unique_ptr<Iterator> iterator(createPriceOrderedIterator());
+        for (size_t shown = 0; shown < pageSize && iterator->hasNext(); ++shown)
+        {
+            MenuItem *item = static_cast<MenuItem *>(iterator->next());
+            std::cout << item->getName() << ", " << item->getPrice() << " -- " << item->getDescription() << std::endl;
+        }
+    }
+
     void printVegetarianMenu()
     {
         std::cout << "Vegetarian Menu:" << std::endl;
@@ -261,28 +1713,642 @@ public:
         printMenu(*dinerIterator);
     }
 
-    bool isItemVegetarian(const std::string &name)
+    bool isItemVegetarian(const std::string &name) const
+    {
+        return item_index.isVegetarian(name);
+    }
+
+    bool hasItem(const std::string &name) const
+    {
+        return item_index.contains(name);
+    }
+
+    double getItemPrice(const std::string &name) const
+    {
+        return item_index.getPrice(name);
+    }
+
+    template <typename Predicate>
+    std::vector<MenuItem> filter(Predicate predicate)
+    {
+        return project([](const MenuItem &item)
+                       { return item; },
+                       predicate);
+    }
+
+    template <typename Projection, typename Predicate>
+    auto project(Projection projection, Predicate predicate)
+    {
+        using Row = decltype(projection(std::declval<const MenuItem &>()));
+        return queryMenus<std::vector<Row>>(
+            [&](Menu &menu, std::vector<Row> &rows)
+            {
+                auto visit = [&](const MenuItem &item)
+                {
+                    if (predicate(item))
+                    {
+                        rows.push_back(projection(item));
+                    }
+                };
+                forEachItem(menu, visit);
+            },
+            [](std::vector<Row> &rows, std::vector<Row> partial)
+            {
+                rows.insert(rows.end(), std::make_move_iterator(partial.begin()), std::make_move_iterator(partial.end()));
+            });
+    }
+
+    template <typename Predicate>
+    size_t count(Predicate predicate)
+    {
+        return queryMenus<size_t>(
+            [&](Menu &menu, size_t &total)
+            {
+                auto visit = [&](const MenuItem &item)
+                {
+                    total += predicate(item) ? 1 : 0;
+                };
+                forEachItem(menu, visit);
+            },
+            [](size_t &total, size_t partial)
+            {
+                total += partial;
+            });
+    }
+
+    std::vector<MenuItem> cheapestItems(size_t k)
+    {
+        std::vector<MenuItem> heap = queryMenus<std::vector<MenuItem>>(
+            [k](Menu &menu, std::vector<MenuItem> &partial)
+            {
+                auto visit = [&](const MenuItem &item)
+                {
+                    keepCheapest(partial, item, k);
+                };
+                forEachItem(menu, visit);
+            },
+            [k](std::vector<MenuItem> &result, const std::vector<MenuItem> &partial)
+            {
+                for (const MenuItem &item : partial)
+                {
+                    keepCheapest(result, item, k);
+                }
+            });
+        std::sort_heap(heap.begin(), heap.end(), cheaper);
+        return heap;
+    }
+};
+
+std::atomic<size_t> allocationCount{0};
+
+// All replacements stay out of line so that GCC does not see malloc and free
+// through them and warn that new and delete are mismatched.
+[[gnu::noinline]] void *operator new(size_t size)
+{
+    ++allocationCount;
+    if (void *memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void *operator new(size_t size, std::align_val_t alignment)
+{
+    ++allocationCount;
+    size_t align = static_cast<size_t>(alignment);
+    if (void *memory = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+        return memory;
+    throw std::bad_alloc();
+}
+
+// std::stable_sort takes its scratch buffer from the nothrow form.
+[[gnu::noinline]] void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    ++allocationCount;
+    return std::malloc(size ? size : 1);
+}
+
+[[gnu::noinline]] void operator delete(void *memory) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, size_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+[[gnu::noinline]] void operator delete(void *memory, size_t, std::align_val_t) noexcept { std::free(memory); }
+
+struct BenchmarkRun
+{
+    double seconds;
+    size_t allocations;
+};
+
+template <typename F>
+BenchmarkRun measure(F &&work)
+{
+    size_t allocations = allocationCount.load();
+    auto begin = std::chrono::steady_clock::now();
+    work();
+    return BenchmarkRun{std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count(),
+                        allocationCount.load() - allocations};
+}
+
+void benchmarkIndex(size_t items)
+{
+    const size_t MENUS = 1000;
+    const size_t SCANNED_LOOKUPS = 20;
+    std::vector<std::unique_ptr<ColumnarMenu>> menus;
+    std::unordered_map<std::string, Menu *> menu_by_name;
+    for (size_t m = 0; m < MENUS; ++m)
     {
-        for (const auto &[menuName, menu] : menu_by_name)
+        menus.push_back(std::make_unique<ColumnarMenu>());
+        for (size_t i = m; i < items; i += MENUS)
         {
-            std::unique_ptr<Iterator> iterator(menu->createIterator());
-            if (isVegetarian(*iterator, name))
+            // Every name is offered by two menus, at different prices.
+            menus.back()->addItem("dish " + std::to_string(i % (items / 2)), "house special", i % 3 == 0, 1.0 + i % 500 / 10.0);
+        }
+        menu_by_name.emplace("restaurant " + std::to_string(m), menus.back().get());
+    }
+
+    std::unique_ptr<Waitress> waitress;
+    BenchmarkRun build = measure([&]
+                                 { waitress = std::make_unique<Waitress>(menu_by_name, 1); });
+
+    std::vector<std::string> queries;
+    for (size_t i = 0; i < items; ++i)
+    {
+        // One query in ten names no item at all.
+        size_t dish = i * 7919 % items;
+        queries.push_back(i % 10 == 0 ? "missing " + std::to_string(dish) : "dish " + std::to_string(dish / 2));
+    }
+
+    size_t vegetarian = 0;
+    double priceSum = 0;
+    BenchmarkRun indexed = measure([&]
+                                   {
+                                       for (const std::string &name : queries)
+                                       {
+                                           if (waitress->hasItem(name))
+                                           {
+                                               vegetarian += waitress->isItemVegetarian(name);
+                                               priceSum += waitress->getItemPrice(name);
+                                           }
+                                       } });
+
+    size_t scannedHits = 0;
+    BenchmarkRun scanned = measure([&]
+                                   {
+                                       for (size_t q = 0; q < SCANNED_LOOKUPS; ++q)
+                                       {
+                                           const std::string &name = queries[q * queries.size() / SCANNED_LOOKUPS + 1];
+                                           bool found = false;
+                                           for (const auto &menu : menus)
+                                           {
+                                               std::unique_ptr<Iterator> iterator(menu->createIterator());
+                                               while (!found && iterator->hasNext())
+                                               {
+                                                   found = static_cast<MenuItem *>(iterator->next())->getName() == name;
+                                               }
+                                           }
+                                           scannedHits += found;
+                                       } });
+
+    std::cout << "index: " << items << " items across " << MENUS << " menus, "
+              << vegetarian << " vegetarian hits, price sum " << priceSum << "\n"
+              << "  index build: " << build.seconds << " s\n"
+              << "  indexed lookup (contains, vegetarian, price): " << indexed.seconds * 1e9 / queries.size()
+              << " ns, " << static_cast<double>(indexed.allocations) / queries.size() << " allocations per query\n"
+              << "  iterator scan: " << scanned.seconds * 1e3 / SCANNED_LOOKUPS << " ms per lookup ("
+              << scannedHits << " of " << SCANNED_LOOKUPS << " found)\n";
+}
+
+void benchmarkColumnar(size_t rows)
+{
+    const double MAX_PRICE = 5.0;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        names.push_back("dish " + std::to_string(i));
+    }
+    auto priceOf = [](size_t row)
+    { return 1.0 + row * 2654435761u % 1900 / 100.0; };
+
+    ColumnarMenu columnar;
+    std::vector<MenuItem> items;
+    items.reserve(rows);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        columnar.addItem(names[row % names.size()], "house special", row % 3 == 0, priceOf(row));
+        items.emplace_back(names[row % names.size()], "house special", row % 3 == 0, priceOf(row));
+    }
+    // DinerMenu also keeps its four demo items, so it finds one extra match.
+    DinerMenu diner;
+    diner.addItems(items);
+    items = std::vector<MenuItem>();
+
+    auto report = [rows](const char *scan, const BenchmarkRun &run, size_t matches)
+    {
+        std::cout << "  " << scan << ": " << rows / run.seconds / 1e6 << "M rows/s, " << matches << " matches\n";
+    };
+    std::cout << "columnar: vegetarian items under " << MAX_PRICE << " in " << rows << " rows\n";
+
+    std::vector<size_t> selection;
+    BenchmarkRun vectorScan = measure([&]
+                                      { selection = columnar.selectVegetarianPriceBelow(MAX_PRICE); });
+    report("columnar vector scan", vectorScan, selection.size());
+
+    size_t matches = 0;
+    BenchmarkRun rowViews = measure([&]
+                                    {
+                                        for (ColumnarMenu::Row row : columnar.rows())
+                                        {
+                                            matches += row.isVegetarian() && row.getPrice() < MAX_PRICE;
+                                        } });
+    report("columnar row views", rowViews, matches);
+
+    auto scan = [&](Menu &menu)
+    {
+        return measure([&]
+                       {
+                           matches = 0;
+                           std::unique_ptr<Iterator> iterator(menu.createIterator());
+                           while (iterator->hasNext())
+                           {
+                               MenuItem *item = static_cast<MenuItem *>(iterator->next());
+                               matches += item->isVegetarian() && item->getPrice() < MAX_PRICE;
+                           } });
+    };
+    BenchmarkRun columnarIterator = scan(columnar);
+    report("columnar through Iterator", columnarIterator, matches);
+    BenchmarkRun dinerIterator = scan(diner);
+    report("array of MenuItem through Iterator", dinerIterator, matches);
+}
+
+void benchmarkQueries(size_t items)
+{
+    const size_t MENUS = 2000;
+    const size_t REPEATS = 5;
+    std::vector<std::unique_ptr<ColumnarMenu>> menus;
+    std::unordered_map<std::string, Menu *> menu_by_name;
+    for (size_t m = 0; m < MENUS; ++m)
+    {
+        menus.push_back(std::make_unique<ColumnarMenu>());
+        for (size_t i = m; i < items; i += MENUS)
+        {
+            menus.back()->addItem("dish " + std::to_string(i % 5000), "house special", i % 3 == 0, 1.0 + i * 2654435761u % 1900 / 100.0);
+        }
+        menu_by_name.emplace("restaurant " + std::to_string(m), menus.back().get());
+    }
+    std::unordered_map<std::string, Menu *> small_menu_by_name(menu_by_name.begin(), std::next(menu_by_name.begin(), 4));
+
+    auto vegetarian = [](const MenuItem &item)
+    { return item.isVegetarian(); };
+    std::cout << "queries: " << items << " items across " << MENUS << " menus, best of " << REPEATS << " runs, "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    for (size_t threads : {1, 2, 4, 8, 16, 32})
+    {
+        Waitress waitress(menu_by_name, threads);
+        double countSeconds = std::numeric_limits<double>::infinity();
+        double cheapestSeconds = std::numeric_limits<double>::infinity();
+        size_t found = 0;
+        for (size_t repeat = 0; repeat < REPEATS; ++repeat)
+        {
+            countSeconds = std::min(countSeconds, measure([&]
+                                                          { found = waitress.count(vegetarian); })
+                                                      .seconds);
+            cheapestSeconds = std::min(cheapestSeconds, measure([&]
+                                                                { waitress.cheapestItems(10); })
+                                                            .seconds);
+        }
+        Waitress small(small_menu_by_name, threads);
+        BenchmarkRun smallCount = measure([&]
+                                          { small.count(vegetarian); });
+        std::cout << "  " << threads << " threads: count " << countSeconds * 1e3 << " ms (" << found
+                  << " vegetarian), top 10 by price " << cheapestSeconds * 1e3 << " ms, count over "
+                  << small.count(vegetarian) << "-item menus " << smallCount.seconds * 1e6 << " us\n";
+    }
+}
+
+void benchmarkPageOne(size_t items)
+{
+    const size_t MENUS = 1000;
+    const size_t PAGE_SIZE = 10;
+    const size_t REQUESTS = 100;
+    std::vector<std::unique_ptr<ColumnarMenu>> menus;
+    std::unordered_map<std::string, Menu *> menu_by_name;
+    for (size_t m = 0; m < MENUS; ++m)
+    {
+        menus.push_back(std::make_unique<ColumnarMenu>());
+        for (size_t i = m; i < items; i += MENUS)
+        {
+            menus.back()->addItem("dish " + std::to_string(i % 5000), "house special", i % 3 == 0, 1.0 + i * 2654435761u % 190000 / 10000.0);
+        }
+        menu_by_name.emplace("restaurant " + std::to_string(m), menus.back().get());
+    }
+    Waitress waitress(menu_by_name, 1);
+
+    std::vector<double> page;
+    auto firstPage = [&]
+    {
+        page.clear();
+        std::unique_ptr<Iterator> iterator(waitress.createPriceOrderedIterator());
+        for (size_t shown = 0; shown < PAGE_SIZE && iterator->hasNext(); ++shown)
+        {
+            page.push_back(static_cast<MenuItem *>(iterator->next())->getPrice());
+        }
+    };
+    BenchmarkRun cold = measure(firstPage);
+    BenchmarkRun warm = measure([&]
+                                {
+                                    for (size_t request = 0; request < REQUESTS; ++request)
+                                    {
+                                        firstPage();
+                                    } });
+
+    std::vector<double> sortedPage;
+    BenchmarkRun sorted = measure([&]
+                                  {
+                                      std::vector<MenuItem> all;
+                                      for (const auto &menu : menus)
+                                      {
+                                          std::unique_ptr<Iterator> iterator(menu->createIterator());
+                                          while (iterator->hasNext())
+                                          {
+                                              all.push_back(*static_cast<MenuItem *>(iterator->next()));
+                                          }
+                                      }
+                                      std::stable_sort(all.begin(), all.end(), [](const MenuItem &a, const MenuItem &b)
+                                                       { return a.getPrice() < b.getPrice(); });
+                                      for (size_t shown = 0; shown < PAGE_SIZE && shown < all.size(); ++shown)
+                                      {
+                                          sortedPage.push_back(all[shown].getPrice());
+                                      } });
+
+    std::cout << "page-one: first " << PAGE_SIZE << " items by price out of " << items << " across " << MENUS
+              << " menus, " << (page == sortedPage ? "merge and sort agree" : "MERGE AND SORT DISAGREE") << "\n"
+              << "  merge, first request (builds each menu's price index): " << cold.seconds * 1e3 << " ms\n"
+              << "  merge, later requests: " << warm.seconds * 1e3 / REQUESTS << " ms, "
+              << warm.allocations / REQUESTS << " allocations per page\n"
+              << "  copy and sort everything: " << sorted.seconds * 1e3 << " ms\n";
+}
+
+void benchmarkText(size_t items)
+{
+    const size_t DESCRIPTIONS = 100;
+    std::vector<std::string> names;
+    std::vector<std::string> descriptions;
+    for (size_t d = 0; d < DESCRIPTIONS; ++d)
+    {
+        descriptions.push_back("House recipe " + std::to_string(d) + ", served with a side salad and fresh bread");
+    }
+    std::vector<MenuItem> batch;
+    for (size_t i = 0; i < items; ++i)
+    {
+        names.push_back("Blue plate special number " + std::to_string(i));
+    }
+    for (size_t i = 0; i < items; ++i)
+    {
+        batch.emplace_back(names[i], descriptions[i % DESCRIPTIONS], i % 3 == 0, 1.0 + i % 500 / 10.0);
+    }
+
+    size_t bytes = mallinfo2().uordblks;
+    DinerMenu diner;
+    BenchmarkRun build = measure([&]
+                                 { diner.addItems(batch); });
+    bytes = mallinfo2().uordblks - bytes;
+
+    const std::string &probe = names[items / 2];
+    size_t found = 0;
+    size_t descriptionBytes = 0;
+    BenchmarkRun scan = measure([&]
+                                {
+                                    std::unique_ptr<Iterator> iterator(diner.createIterator());
+                                    while (iterator->hasNext())
+                                    {
+                                        MenuItem *item = static_cast<MenuItem *>(iterator->next());
+                                        found += item->getName() == probe;
+                                        descriptionBytes += item->getDescription().size();
+                                    } });
+
+    std::cout << "text: " << items << " items, " << DESCRIPTIONS << " distinct descriptions\n"
+              << "  build: " << build.seconds << " s, " << build.allocations << " allocations, "
+              << bytes / 1e6 << " MB live (" << static_cast<double>(bytes) / items << " bytes per item)\n"
+              << "  name and description scan: " << scan.seconds * 1e3 << " ms, " << scan.allocations
+              << " allocations (" << found << " match, " << descriptionBytes / 1e6 << " MB of descriptions read)\n";
+}
+
+void benchmarkCatalog(size_t items)
+{
+    const size_t DESCRIPTIONS = 100;
+    const size_t PAGE_SIZE = 10;
+    std::vector<std::string> descriptions;
+    for (size_t d = 0; d < DESCRIPTIONS; ++d)
+    {
+        descriptions.push_back("House recipe " + std::to_string(d) + ", served with a side salad and fresh bread");
+    }
+    auto nameOf = [](size_t i)
+    { return "Blue plate special number " + std::to_string(i); };
+    auto priceOf = [](size_t i)
+    { return 1.0 + i * 2654435761u % 190000 / 10000.0; };
+
+    std::string path = (std::filesystem::temp_directory_path() / "benchmark_menu.XXXXXX").string();
+    int file = mkstemp(path.data());
+    if (file < 0)
+    {
+        std::cerr << "Cannot create a temporary menu catalog\n";
+        return;
+    }
+    close(file);
+
+    BenchmarkRun written = measure([&]
+                                   {
+                                       CatalogBuilder builder;
+                                       for (size_t i = 0; i < items; ++i)
+                                       {
+                                           builder.addItem(nameOf(i), descriptions[i % DESCRIPTIONS], i % 3 == 0, priceOf(i));
+                                       }
+                                       builder.write(path); });
+
+    // What the menu constructors do today: build every item in memory.
+    BenchmarkRun built = measure([&]
+                                 {
+                                     std::vector<std::string> names;
+                                     std::vector<MenuItem> batch;
+                                     for (size_t i = 0; i < items; ++i)
+                                     {
+                                         names.push_back(nameOf(i));
+                                     }
+                                     for (size_t i = 0; i < items; ++i)
+                                     {
+                                         batch.emplace_back(names[i], descriptions[i % DESCRIPTIONS], i % 3 == 0, priceOf(i));
+                                     }
+                                     DinerMenu diner;
+                                     diner.addItems(batch); });
+
+    // Best effort: flush the catalog and drop its pages from the page cache,
+    // so that the next open has to read it from disk.
+    auto evict = [&path]
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        bool evicted = fd >= 0 && fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return evicted;
+    };
+    auto startup = [&](const char *label)
+    {
+        std::unique_ptr<MappedCatalogMenu> catalog;
+        BenchmarkRun opened = measure([&]
+                                      { catalog = std::make_unique<MappedCatalogMenu>(path); });
+        double cheapest = 0;
+        BenchmarkRun page = measure([&]
+                                    {
+                                        std::unique_ptr<Iterator> iterator(catalog->createPriceOrderedIterator());
+                                        for (size_t shown = 0; shown < PAGE_SIZE && iterator->hasNext(); ++shown)
+                                        {
+                                            cheapest += static_cast<MenuItem *>(iterator->next())->getPrice();
+                                        } });
+        size_t nameBytes = 0;
+        BenchmarkRun scan = measure([&]
+                                    {
+                                        std::unique_ptr<Iterator> iterator(catalog->createIterator());
+                                        while (iterator->hasNext())
+                                        {
+                                            nameBytes += static_cast<MenuItem *>(iterator->next())->getName().size();
+                                        } });
+        std::cout << "  " << label << ": open " << opened.seconds * 1e6 << " us, first page by price "
+                  << page.seconds * 1e6 << " us, full scan " << scan.seconds * 1e3 << " ms (" << nameBytes / 1e6
+                  << " MB of names)\n";
+    };
+
+    std::cout << "catalog: " << items << " items, " << std::filesystem::file_size(path) / 1e6 << " MB file\n"
+              << "  build and write catalog: " << written.seconds << " s\n"
+              << "  build DinerMenu in memory: " << built.seconds << " s\n";
+    bool evicted = evict();
+    startup(evicted ? "cold" : "cold (page cache eviction failed)");
+    startup("warm");
+    std::remove(path.c_str());
+}
+
+void benchmarkSnapshots(size_t items)
+{
+    const size_t READERS = 2;
+    const auto DURATION = std::chrono::seconds(1);
+    std::vector<std::string> names;
+    std::vector<MenuItem> batch;
+    for (size_t i = 0; i < items; ++i)
+    {
+        names.push_back("dish " + std::to_string(i));
+    }
+    for (size_t i = 0; i < items; ++i)
+    {
+        batch.emplace_back(names[i], "house special", i % 3 == 0, 1.0 + i % 500 / 10.0);
+    }
+    DinerMenu diner;
+    diner.addItems(batch);
+
+    std::cout << "snapshots: " << READERS << " readers iterating a " << diner.getNumberOfItems()
+              << "-item DinerMenu for " << DURATION.count() << " s per write rate\n";
+    for (size_t writesPerSecond : {0, 100, 1000, 10000})
+    {
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> readItems{0};
+        std::vector<std::thread> readers;
+        for (size_t r = 0; r < READERS; ++r)
+        {
+            readers.emplace_back([&]
+                                 {
+                                     while (!stop.load())
+                                     {
+                                         size_t seen = 0;
+                                         std::unique_ptr<Iterator> iterator(diner.createIterator());
+                                         while (iterator->hasNext())
+                                         {
+                                             iterator->next();
+                                             ++seen;
+                                         }
+                                         readItems += seen;
+                                     } });
+        }
+
+        size_t writes = 0;
+        auto begin = std::chrono::steady_clock::now();
+        auto end = begin + DURATION;
+        for (auto now = begin; now < end; now = std::chrono::steady_clock::now())
+        {
+            if (writesPerSecond == 0)
             {
-                return true;
+                std::this_thread::sleep_until(end);
+                continue;
             }
+            diner.updatePrice(names[writes % items], 1.0 + writes % 700 / 10.0);
+            ++writes;
+            std::this_thread::sleep_until(begin + std::chrono::microseconds(writes * 1000000 / writesPerSecond));
+        }
+        stop = true;
+        for (std::thread &reader : readers)
+        {
+            reader.join();
         }
-        return false;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "  target " << writesPerSecond << " writes/s: " << writes / seconds << " writes/s achieved, "
+                  << readItems.load() / seconds / 1e6 << "M items read/s\n";
     }
-};
+}
+
+int runBenchmarks(int argc, char **argv)
+{
+    struct Benchmark
+    {
+        const char *name;
+        void (*run)(size_t);
+        size_t defaultScale;
+    };
+    const Benchmark benchmarks[] = {
+        {"index", benchmarkIndex, 1000000},
+        {"columnar", benchmarkColumnar, 10000000},
+        {"queries", benchmarkQueries, 2000000},
+        {"page-one", benchmarkPageOne, 1000000},
+        {"text", benchmarkText, 1000000},
+        {"catalog", benchmarkCatalog, 5000000},
+        {"snapshots", benchmarkSnapshots, 10000},
+    };
+    std::string_view only = argc > 0 ? argv[0] : "";
+    size_t scale = argc > 1 ? std::stoull(argv[1]) : 0;
+    bool ran = false;
+    for (const Benchmark &benchmark : benchmarks)
+    {
+        if (only.empty() || only == benchmark.name)
+        {
+            benchmark.run(scale ? scale : benchmark.defaultScale);
+            ran = true;
+        }
+    }
+    if (!ran)
+    {
+        std::cerr << "Unknown benchmark: " << only << "\n";
+        return 1;
+    }
+    return 0;
+}
 
-int main()
+// Run with --benchmark [name] [scale] to time the menus instead of printing
+// the demo.
+int main(int argc, char **argv)
 {
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark")
+    {
+        return runBenchmarks(argc - 2, argv + 2);
+    }
+
     PancakeHouseMenu *pancakeHouseMenu = new PancakeHouseMenu();
     DinerMenu *dinerMenu = new DinerMenu();
     CafeMenu *cafeMenu = new CafeMenu();
+    ColumnarMenu *bistroMenu = new ColumnarMenu();
+    bistroMenu->addItem("Caprese Salad", "Tomato, mozzarella and basil", true, 4.25);
+    bistroMenu->addItem("Steak Frites", "Grilled steak with fries", false, 9.50);
+    bistroMenu->addItem("Ratatouille", "Stewed summer vegetables", true, 6.75);
     Waitress *waitress = new Waitress({{"Pancake House", pancakeHouseMenu},
                                        {"Diner", dinerMenu},
-                                       {"Cafe", cafeMenu}});
+                                       {"Cafe", cafeMenu},
+                                       {"Bistro", bistroMenu}});
 
     waitress->printMenu();
     std::cout << std::endl;
@@ -290,14 +2356,76 @@ int main()
     waitress->printVegetarianMenu();
     std::cout << std::endl;
 
+    waitress->printMenuByPrice(5);
+    std::cout << std::endl;
+
     std::string itemName = "Vegetarian BLT";
     std::cout << itemName << " is "
               << (waitress->isItemVegetarian(itemName) ? "vegetarian." : "not vegetarian.") << std::endl;
 
+    dinerMenu->addItem("Pasta", "Spaghetti with Marinara Sauce, and a slice of sourdough bread", true, 3.89);
+    std::cout << "Pasta costs " << waitress->getItemPrice("Pasta") << std::endl;
+    {
+        std::unique_ptr<Iterator> pinned(dinerMenu->createIterator());
+        dinerMenu->updatePrice("Pasta", 4.19);
+        int pinnedItems = 0;
+        while (pinned->hasNext())
+        {
+            pinned->next();
+            ++pinnedItems;
+        }
+        std::cout << "Pasta now costs " << waitress->getItemPrice("Pasta")
+                  << ", pinned snapshot still saw " << pinnedItems << " diner items" << std::endl;
+    }
+
+    std::cout << std::endl
+              << "Bistro vegetarian items under 5.00:" << std::endl;
+    std::vector<size_t> cheapVegetarian = bistroMenu->selectVegetarianPriceBelow(5.00);
+    for (ColumnarMenu::Row row : bistroMenu->rows(cheapVegetarian))
+    {
+        std::cout << row.getName() << ", " << row.getPrice() << std::endl;
+    }
+
+    std::cout << std::endl
+              << waitress->count([](const MenuItem &item)
+                                 { return item.isVegetarian(); })
+              << " vegetarian items" << std::endl
+              << "Three cheapest items:" << std::endl;
+    for (const MenuItem &item : waitress->cheapestItems(3))
+    {
+        std::cout << item.getName() << ", " << item.getPrice() << std::endl;
+    }
+
+    std::string catalogPath = (std::filesystem::temp_directory_path() / "diner_menu.XXXXXX").string();
+    int catalogFile = mkstemp(catalogPath.data());
+    if (catalogFile < 0)
+    {
+        std::cerr << "Cannot create a temporary menu catalog" << std::endl;
+        return 1;
+    }
+    close(catalogFile);
+    CatalogBuilder builder;
+    builder.addMenu(*dinerMenu);
+    builder.addMenu(*cafeMenu);
+    builder.write(catalogPath);
+    {
+        MappedCatalogMenu catalogMenu(catalogPath);
+        std::cout << std::endl
+                  << "Catalog Menu by Price:" << std::endl;
+        std::unique_ptr<Iterator> iterator(catalogMenu.createPriceOrderedIterator());
+        while (iterator->hasNext())
+        {
+            MenuItem *item = static_cast<MenuItem *>(iterator->next());
+            std::cout << item->getName() << ", " << item->getPrice() << std::endl;
+        }
+    }
+    std::remove(catalogPath.c_str());
+
     delete waitress;
     delete dinerMenu;
     delete pancakeHouseMenu;
     delete cafeMenu;
+    delete bistroMenu;
 
     return 0;
 }